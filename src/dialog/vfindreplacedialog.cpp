@@ -31,6 +31,7 @@ void VFindReplaceDialog::setupUI()
     m_findNextBtn->setDefault(true);
     m_findPrevBtn = new QPushButton(tr("Find &Previous"));
     m_findPrevBtn->setProperty("FlatBtn", true);
+    m_countLabel = new QLabel();
 
     // Replace
     QLabel *replaceLabel = new QLabel(tr("&Replace with:"));
@@ -66,6 +67,7 @@ void VFindReplaceDialog::setupUI()
     gridLayout->addWidget(m_findEdit, 0, 1);
     gridLayout->addWidget(m_findNextBtn, 0, 2);
     gridLayout->addWidget(m_findPrevBtn, 0, 3);
+    gridLayout->addWidget(m_countLabel, 0, 4, 1, 2);
     gridLayout->addWidget(replaceLabel, 1, 0);
     gridLayout->addWidget(m_replaceEdit, 1, 1);
     gridLayout->addWidget(m_replaceBtn, 1, 2);
@@ -187,6 +189,7 @@ void VFindReplaceDialog::openDialog(QString p_text)
 
 void VFindReplaceDialog::handleFindTextChanged(const QString &p_text)
 {
+    m_countLabel->clear();
     emit findTextChanged(p_text, m_options);
 }
 
@@ -223,6 +226,7 @@ void VFindReplaceDialog::optionBoxToggled(int p_state)
     } else {
         m_options &= ~opt;
     }
+    m_countLabel->clear();
     emit findOptionChanged(m_options);
 }
 
@@ -300,3 +304,12 @@ void VFindReplaceDialog::updateState(DocType p_docType, bool p_editMode)
     }
     m_replaceAvailable = p_editMode;
 }
+
+void VFindReplaceDialog::setMatchCount(const QString &p_text, uint p_options,
+                                       int p_count)
+{
+    if (p_text != m_findEdit->text() || p_options != m_options) {
+        return;
+    }
+    m_countLabel->setText(tr("%1 match(es)").arg(p_count));
+}
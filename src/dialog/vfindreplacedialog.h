@@ -8,6 +8,7 @@
 class QLineEdit;
 class QPushButton;
 class QCheckBox;
+class QLabel;
 
 enum FindOption
 {
@@ -26,6 +27,9 @@ public:
     // Update the options enabled/disabled state according to current
     // edit tab.
     void updateState(DocType p_docType, bool p_editMode);
+    // Show the total number of matches of @p_text if it is still the
+    // text being searched.
+    void setMatchCount(const QString &p_text, uint p_options, int p_count);
 
 signals:
     void dialogClosed();
@@ -62,6 +66,7 @@ private:
 
     QLineEdit *m_findEdit;
     QLineEdit *m_replaceEdit;
+    QLabel *m_countLabel;
     QPushButton *m_findNextBtn;
     QPushButton *m_findPrevBtn;
     QPushButton *m_replaceBtn;
@@ -21,7 +21,8 @@ void HGMarkdownHighlighter::resizeBuffer(int newCap)
 HGMarkdownHighlighter::HGMarkdownHighlighter(const QVector<HighlightingStyle> &styles, int waitInterval,
                                              QTextDocument *parent)
     : QSyntaxHighlighter(parent), parsing(0),
-      waitInterval(waitInterval), content(NULL), capacity(0), result(NULL)
+      waitInterval(waitInterval), m_suspended(false), m_internalChanges(0), m_nrBlocks(0),
+      m_nrParses(0), content(NULL), capacity(0), result(NULL)
 {
     codeBlockStartExp = QRegExp("^(\\s)*```");
     codeBlockEndExp = QRegExp("^(\\s)*```$");
@@ -40,6 +41,7 @@ HGMarkdownHighlighter::HGMarkdownHighlighter(const QVector<HighlightingStyle> &s
     resizeBuffer(initCapacity);
     setStyles(styles);
     document = parent;
+    m_nrBlocks = document->blockCount();
     timer = new QTimer(this);
     timer->setSingleShot(true);
     timer->setInterval(this->waitInterval);
@@ -63,6 +65,10 @@ HGMarkdownHighlighter::~HGMarkdownHighlighter()
 
 void HGMarkdownHighlighter::highlightBlock(const QString &text)
 {
+    if (m_suspended) {
+        return;
+    }
+
     int blockNum = currentBlock().blockNumber();
     if (!parsing && blockHighlights.size() > blockNum) {
         QVector<HLUnit> &units = blockHighlights[blockNum];
@@ -274,17 +280,68 @@ void HGMarkdownHighlighter::parseInternal()
     pmh_markdown_to_elements(content, pmh_EXT_NONE, &result);
 }
 
-void HGMarkdownHighlighter::handleContentChange(int /* position */, int charsRemoved, int charsAdded)
+void HGMarkdownHighlighter::handleContentChange(int position, int charsRemoved, int charsAdded)
 {
-    if (charsRemoved == 0 && charsAdded == 0) {
+    int nrBlocks = document->blockCount();
+    int delta = nrBlocks - m_nrBlocks;
+    m_nrBlocks = nrBlocks;
+    if (m_suspended || (charsRemoved == 0 && charsAdded == 0)) {
         return;
     }
+    if (m_internalChanges > 0) {
+        shiftBlocks(document->findBlock(position).blockNumber(), delta);
+        return;
+    }
+    m_nrParses = 0;
     timer->stop();
     timer->start();
 }
 
+void HGMarkdownHighlighter::shiftBlocks(int p_block, int p_delta)
+{
+    if (p_delta == 0) {
+        return;
+    }
+    // Blocks are inserted or removed after @p_block.
+    int idx = p_block + 1;
+    if (idx <= blockHighlights.size()) {
+        if (p_delta > 0) {
+            blockHighlights.insert(idx, p_delta, QVector<HLUnit>());
+        } else {
+            blockHighlights.remove(idx, qMin(-p_delta, blockHighlights.size() - idx));
+        }
+    }
+
+    QSet<int> blocks;
+    for (auto it = imageBlocks.begin(); it != imageBlocks.end(); ++it) {
+        int block = *it;
+        if (block > p_block) {
+            block += p_delta;
+            if (block <= p_block) {
+                // Removed.
+                continue;
+            }
+        }
+        blocks.insert(block);
+    }
+    imageBlocks = blocks;
+}
+
+void HGMarkdownHighlighter::beginInternalChange()
+{
+    ++m_internalChanges;
+}
+
+void HGMarkdownHighlighter::endInternalChange()
+{
+    Q_ASSERT(m_internalChanges > 0);
+    --m_internalChanges;
+}
+
 void HGMarkdownHighlighter::timerTimeout()
 {
+    ++m_nrParses;
+    qDebug() << "parse" << m_nrParses << "time(s) since last edit";
     parse();
     rehighlight();
     emit highlightCompleted();
@@ -295,3 +352,18 @@ void HGMarkdownHighlighter::updateHighlight()
     timer->stop();
     timerTimeout();
 }
+
+void HGMarkdownHighlighter::suspend()
+{
+    m_suspended = true;
+    timer->stop();
+}
+
+void HGMarkdownHighlighter::resume()
+{
+    if (!m_suspended) {
+        return;
+    }
+    m_suspended = false;
+    updateHighlight();
+}
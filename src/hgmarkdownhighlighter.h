@@ -49,6 +49,17 @@ public:
     void setStyles(const QVector<HighlightingStyle> &styles);
     // Request to update highlihgt (re-parse and re-highlight)
     void updateHighlight();
+    // Stop parsing and highlighting until resume(), such as during loading
+    // a large file.
+    void suspend();
+    // Resume and update the highlight.
+    void resume();
+    // Document changes between beginInternalChange() and endInternalChange()
+    // are made by the editor itself, such as image preview blocks. They do
+    // not trigger re-parsing. The highlights are shifted to follow the
+    // inserted or removed blocks instead.
+    void beginInternalChange();
+    void endInternalChange();
 
 signals:
     void highlightCompleted();
@@ -76,6 +87,12 @@ private:
     QAtomicInt parsing;
     QTimer *timer;
     int waitInterval;
+    bool m_suspended;
+    int m_internalChanges;
+    // Block count of the document after last change.
+    int m_nrBlocks;
+    // Parses since last change not made by the editor, for debugging.
+    int m_nrParses;
 
     char *content;
     int capacity;
@@ -92,6 +109,8 @@ private:
     void initBlockHighlihgtOne(unsigned long pos, unsigned long end,
                                int styleIndex);
     void updateImageBlocks();
+    // Shift the blocks after @p_block by @p_delta.
+    void shiftBlocks(int p_block, int p_delta);
 };
 
 #endif
@@ -1,9 +1,10 @@
 var placeholder = document.getElementById('placeholder');
 
-var updateHtml = function(html) {
-    placeholder.innerHTML = html;
-    var codes = document.getElementsByTagName('code');
-    mermaidIdx = 0;
+// Nodes of each top-level block patched by key in live preview.
+var fragmentNodes = {};
+
+// Highlight code blocks and render Mermaid diagrams within @codes.
+var renderCodeBlocks = function(codes) {
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.parentElement.tagName.toLowerCase() == 'pre') {
@@ -27,21 +28,97 @@ var updateHtml = function(html) {
                 var preNode = code.parentNode;
                 preNode.classList.add(VMermaidDivClass);
                 preNode.replaceChild(graphDiv, code);
-                // replaceChild() will decrease codes.length.
-                --i;
             } else {
                 hljs.highlightBlock(code);
             }
         }
     }
+};
 
+var typesetMath = function(element) {
     // MathJax may be not loaded for now.
     if (VEnableMathjax && (typeof MathJax != "undefined")) {
         try {
-            MathJax.Hub.Queue(["Typeset", MathJax.Hub, placeholder]);
+            MathJax.Hub.Queue(["Typeset", MathJax.Hub, element]);
         } catch (err) {
             content.setLog("err: " + err);
         }
     }
 };
 
+var updateHtml = function(html) {
+    placeholder.innerHTML = html;
+    fragmentNodes = {};
+    mermaidIdx = 0;
+    // Copy the list since rendering Mermaid will remove <code> elements.
+    renderCodeBlocks(Array.prototype.slice.call(placeholder.getElementsByTagName('code')));
+    typesetMath(placeholder);
+    scrollToPendingAnchor();
+};
+
+// Update the blocks with @keys in order. Blocks not changed are moved in place,
+// keeping their Mermaid diagrams and MathJax output. @fragments contains the
+// HTML of the new blocks.
+var patchHtml = function(keys, fragments) {
+    if (Object.keys(fragmentNodes).length == 0) {
+        // Switched from a full update.
+        placeholder.innerHTML = '';
+    }
+    for (var i = 0; i < keys.length; ++i) {
+        if (!(keys[i] in fragments) && !(keys[i] in fragmentNodes)) {
+            content.requestAllFragments();
+            return;
+        }
+    }
+
+    var newFragmentNodes = {};
+    var ordered = [];
+    var added = [];
+    for (var i = 0; i < keys.length; ++i) {
+        var key = keys[i];
+        var nodes = fragmentNodes[key];
+        if (nodes) {
+            delete fragmentNodes[key];
+        } else {
+            var div = document.createElement('div');
+            div.innerHTML = fragments[key];
+            nodes = Array.prototype.slice.call(div.childNodes);
+            Array.prototype.push.apply(added, nodes);
+        }
+        newFragmentNodes[key] = nodes;
+        Array.prototype.push.apply(ordered, nodes);
+    }
+
+    // Remove the blocks gone.
+    for (var key in fragmentNodes) {
+        var nodes = fragmentNodes[key];
+        for (var i = 0; i < nodes.length; ++i) {
+            if (nodes[i].parentNode == placeholder) {
+                placeholder.removeChild(nodes[i]);
+            }
+        }
+    }
+    fragmentNodes = newFragmentNodes;
+
+    var cur = placeholder.firstChild;
+    for (var i = 0; i < ordered.length; ++i) {
+        if (ordered[i] === cur) {
+            cur = cur.nextSibling;
+        } else {
+            placeholder.insertBefore(ordered[i], cur);
+        }
+    }
+
+    for (var i = 0; i < added.length; ++i) {
+        var node = added[i];
+        if (node.nodeType != Node.ELEMENT_NODE) {
+            continue;
+        }
+        var codes = Array.prototype.slice.call(node.getElementsByTagName('code'));
+        if (node.tagName.toLowerCase() == 'code') {
+            codes.push(node);
+        }
+        renderCodeBlocks(codes);
+        typesetMath(node);
+    }
+};
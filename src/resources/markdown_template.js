@@ -8,11 +8,18 @@ new QWebChannel(qt.webChannelTransport,
             updateHtml(content.html);
             content.htmlChanged.connect(updateHtml);
         }
+        if (typeof patchHtml == "function") {
+            content.htmlPatched.connect(patchHtml);
+        }
         if (typeof updateText == "function") {
-            content.textChanged.connect(updateText);
+            content.textChunkReady.connect(handleTextChunk);
             content.updateText();
         }
         content.requestScrollToAnchor.connect(scrollToAnchor);
+        // The request may be sent before the page is loaded.
+        if (content.anchor) {
+            scrollToAnchor(content.anchor);
+        }
     });
 
 var VMermaidDivClass = 'mermaid-diagram';
@@ -28,10 +35,84 @@ if (typeof VEnableMathjax == 'undefined') {
     VEnableMathjax = false;
 }
 
+// Chunks of current text transfer.
+var textId = -1;
+var textChunks = [];
+
+// The text comes in chunks split at block boundaries. Each chunk is rendered
+// and appended once received. The whole text is rendered again at last if it
+// needs the toc section or has link definitions, which may be used by other
+// chunks.
+var handleTextChunk = function(id, index, count, chunk) {
+    if (index == 0) {
+        textId = id;
+        textChunks = [];
+    } else if (id != textId || index != textChunks.length) {
+        // Outdated chunk.
+        return;
+    }
+    textChunks.push(chunk);
+    // Ask for the next chunk before rendering this one.
+    content.textChunkReceived(id, index);
+
+    if (count == 1) {
+        textChunks = [];
+        updateText(chunk);
+        return;
+    }
+
+    if (index == count - 1) {
+        var text = textChunks.join('');
+        textChunks = [];
+        if (mdHasTocSection(text) || /(\n|^) {0,3}\[[^\]]+\]:/.test(text)) {
+            updateText(text);
+            return;
+        }
+    }
+
+    var html = markdownToHtml(chunk, false, index > 0);
+    if (index == 0) {
+        placeholder.innerHTML = html;
+    } else {
+        placeholder.insertAdjacentHTML('beforeend', html);
+    }
+
+    if (index == count - 1) {
+        finishText(false);
+    }
+};
+
+// Called once the whole text is in placeholder.
+var finishText = function(needToc) {
+    handleToc(needToc);
+    renderMermaid('lang-mermaid');
+    if (VEnableMathjax) {
+        try {
+            MathJax.Hub.Queue(["Typeset", MathJax.Hub, placeholder]);
+        } catch (err) {
+            content.setLog("err: " + err);
+        }
+    }
+    scrollToPendingAnchor();
+};
+
+// Anchor not shown yet, such as when the text is still coming in chunks.
+var pendingAnchor = null;
+
 var scrollToAnchor = function(anchor) {
     var anc = document.getElementById(anchor);
     if (anc != null) {
+        pendingAnchor = null;
         anc.scrollIntoView();
+    } else {
+        pendingAnchor = anchor;
+    }
+};
+
+var scrollToPendingAnchor = function() {
+    if (pendingAnchor) {
+        scrollToAnchor(pendingAnchor);
+        pendingAnchor = null;
     }
 };
 
@@ -21,9 +21,13 @@ marked.setOptions({
     }
 });
 
-var markdownToHtml = function(markdown, needToc) {
-    toc = [];
-    nameCounter = 0;
+// Continue the toc of last call if @append is true, such as for the chunks of
+// one text.
+var markdownToHtml = function(markdown, needToc, append) {
+    if (!append) {
+        toc = [];
+        nameCounter = 0;
+    }
     var html = marked(markdown, { renderer: renderer });
     if (needToc) {
         return html.replace(/<p>\[TOC\]<\/p>/ig, '<div class="vnote-toc"></div>');
@@ -120,14 +124,6 @@ var updateText = function(text) {
     var needToc = mdHasTocSection(text);
     var html = markdownToHtml(text, needToc);
     placeholder.innerHTML = html;
-    handleToc(needToc);
-    renderMermaid('lang-mermaid');
-    if (VEnableMathjax) {
-        try {
-            MathJax.Hub.Queue(["Typeset", MathJax.Hub, placeholder]);
-        } catch (err) {
-            content.setLog("err: " + err);
-        }
-    }
+    finishText(needToc);
 };
 
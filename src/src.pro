@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui webenginewidgets webchannel network svg
+QT       += core gui webenginewidgets webchannel network svg concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -28,6 +28,13 @@ SOURCES += main.cpp\
     vedit.cpp \
     vdocument.cpp \
     utils/vutils.cpp \
+    utils/vtextsearcher.cpp \
+    vfilewriter.cpp \
+    veditjournal.cpp \
+    vdocstatistics.cpp \
+    vtextsnapshot.cpp \
+    vrendercache.cpp \
+    vpreviewpool.cpp \
     vpreviewpage.cpp \
     hgmarkdownhighlighter.cpp \
     vstyleparser.cpp \
@@ -72,6 +79,13 @@ HEADERS  += vmainwindow.h \
     vconstants.h \
     vdocument.h \
     utils/vutils.h \
+    utils/vtextsearcher.h \
+    vfilewriter.h \
+    veditjournal.h \
+    vdocstatistics.h \
+    vtextsnapshot.h \
+    vrendercache.h \
+    vpreviewpool.h \
     vpreviewpage.h \
     hgmarkdownhighlighter.h \
     vstyleparser.h \
@@ -109,6 +123,15 @@ RESOURCES += \
     vnote.qrc \
     translations.qrc
 
+# Build the editor on QPlainTextEdit, which lays out the document lazily
+# block by block, with qmake CONFIG+=plain_text_editor. Experimental: the HTML
+# note editor could not lay out tables, lists and images then.
+plain_text_editor {
+    DEFINES += VNOTE_PLAIN_TEXT_EDITOR
+    SOURCES += vimagepreviewhandler.cpp
+    HEADERS += vimagepreviewhandler.h
+}
+
 macx {
     LIBS += -L/usr/local/lib
     INCLUDEPATH += /usr/local/include
@@ -0,0 +1,244 @@
+#include "vtextsearcher.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define V_TEXTSEARCHER_SSE2
+#endif
+
+#include <QHash>
+
+// Characters folding to the same character, for the groups other than one
+// character or a pair of lower and upper case of each other.
+static QHash<ushort, QVector<ushort> > foldGroups()
+{
+    QHash<ushort, QVector<ushort> > groups;
+    for (int i = 0; i < 0x10000; ++i) {
+        QChar ch((ushort)i);
+        groups[ch.toCaseFolded().unicode()].append(ch.unicode());
+    }
+    for (auto it = groups.begin(); it != groups.end();) {
+        const QVector<ushort> &group = it.value();
+        bool pair = false;
+        if (group.size() == 2) {
+            ushort lower = QChar(group[0]).toLower().unicode();
+            ushort upper = QChar(group[0]).toUpper().unicode();
+            pair = (group[0] == lower && group[1] == upper)
+                   || (group[0] == upper && group[1] == lower);
+        }
+        if (group.size() == 1 || pair) {
+            it = groups.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return groups;
+}
+
+bool VTextSearcher::caseVariants(QChar p_ch, ushort p_variants[3])
+{
+    static const QHash<ushort, QVector<ushort> > groups = foldGroups();
+    auto it = groups.constFind(p_ch.toCaseFolded().unicode());
+    if (it == groups.constEnd()) {
+        p_variants[0] = p_ch.toLower().unicode();
+        p_variants[1] = p_ch.toUpper().unicode();
+        p_variants[2] = p_ch.unicode();
+        return true;
+    }
+
+    const QVector<ushort> &group = it.value();
+    if (group.size() > 3) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        p_variants[i] = group[qMin(i, group.size() - 1)];
+    }
+    return true;
+}
+
+VTextSearcher::VTextSearcher(const QString &p_pattern, bool p_caseSensitive,
+                             bool p_wholeWordOnly)
+    : m_pattern(p_pattern), m_caseSensitive(p_caseSensitive),
+      m_wholeWordOnly(p_wholeWordOnly), m_fullScan(false)
+{
+    for (int i = 0; i < 3; ++i) {
+        m_first[i] = m_second[i] = 0;
+    }
+    if (m_pattern.isEmpty()) {
+        return;
+    }
+
+    if (!m_caseSensitive) {
+        m_foldedPattern = m_pattern.toCaseFolded();
+    }
+
+    QChar first = m_pattern.at(0);
+    if (m_caseSensitive) {
+        m_first[0] = m_first[1] = m_first[2] = first.unicode();
+    } else if (!caseVariants(first, m_first)) {
+        m_fullScan = true;
+    }
+
+    if (m_pattern.size() > 1) {
+        QChar second = m_pattern.at(1);
+        if (m_caseSensitive) {
+            m_second[0] = m_second[1] = m_second[2] = second.unicode();
+        } else if (!caseVariants(second, m_second)) {
+            m_fullScan = true;
+        }
+    }
+}
+
+int VTextSearcher::nextCandidate(const ushort *p_data, int p_from, int p_end) const
+{
+    if (m_fullScan) {
+        return p_from < p_end ? p_from : -1;
+    }
+
+    int i = p_from;
+    bool pair = m_pattern.size() > 1;
+
+#if defined(V_TEXTSEARCHER_SSE2)
+    // Compare 8 characters at a time. For a pair, p_end is at most one less
+    // than the size of the text so p_data[i + 8] is still valid.
+    const __m128i first0 = _mm_set1_epi16((short)m_first[0]);
+    const __m128i first1 = _mm_set1_epi16((short)m_first[1]);
+    const __m128i first2 = _mm_set1_epi16((short)m_first[2]);
+    const __m128i second0 = _mm_set1_epi16((short)m_second[0]);
+    const __m128i second1 = _mm_set1_epi16((short)m_second[1]);
+    const __m128i second2 = _mm_set1_epi16((short)m_second[2]);
+    for (; i + 8 <= p_end; i += 8) {
+        __m128i chars = _mm_loadu_si128((const __m128i *)(p_data + i));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(chars, first0),
+                                                 _mm_cmpeq_epi16(chars, first1)),
+                                    _mm_cmpeq_epi16(chars, first2));
+        if (pair) {
+            __m128i nextChars = _mm_loadu_si128((const __m128i *)(p_data + i + 1));
+            __m128i nextHits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(nextChars, second0),
+                                                         _mm_cmpeq_epi16(nextChars, second1)),
+                                            _mm_cmpeq_epi16(nextChars, second2));
+            hits = _mm_and_si128(hits, nextHits);
+        }
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) {
+            int idx = 0;
+            while (!(mask & 1)) {
+                mask >>= 1;
+                ++idx;
+            }
+            // Two bytes per character.
+            return i + idx / 2;
+        }
+    }
+#endif
+
+    for (; i < p_end; ++i) {
+        if (isFirstChar(p_data[i]) && (!pair || isSecondChar(p_data[i + 1]))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool VTextSearcher::matchAt(const ushort *p_data, int p_size, int p_pos) const
+{
+    int len = m_pattern.size();
+    Q_ASSERT(p_pos + len <= p_size);
+    if (m_caseSensitive) {
+        const ushort *pat = m_pattern.utf16();
+        for (int i = 2; i < len; ++i) {
+            if (p_data[p_pos + i] != pat[i]) {
+                return false;
+            }
+        }
+    } else {
+        // The first two characters may be matched by another case variant.
+        const QChar *pat = m_foldedPattern.constData();
+        for (int i = 0; i < len; ++i) {
+            if (QChar(p_data[p_pos + i]).toCaseFolded() != pat[i]) {
+                return false;
+            }
+        }
+    }
+
+    if (m_wholeWordOnly) {
+        // The same rule as QTextDocument::FindWholeWords.
+        if (p_pos > 0 && QChar(p_data[p_pos - 1]).isLetterOrNumber()) {
+            return false;
+        }
+        if (p_pos + len < p_size && QChar(p_data[p_pos + len]).isLetterOrNumber()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int VTextSearcher::indexIn(const QString &p_text, int p_from) const
+{
+    int len = m_pattern.size();
+    int size = p_text.size();
+    if (len == 0 || p_from < 0) {
+        return -1;
+    }
+
+    const ushort *data = p_text.utf16();
+    int end = size - len + 1;
+    int pos = p_from;
+    while (pos < end) {
+        pos = nextCandidate(data, pos, end);
+        if (pos == -1) {
+            break;
+        }
+        if (matchAt(data, size, pos)) {
+            return pos;
+        }
+        ++pos;
+    }
+    return -1;
+}
+
+int VTextSearcher::lastIndexIn(const QString &p_text, int p_from) const
+{
+    int len = m_pattern.size();
+    int size = p_text.size();
+    if (len == 0 || size < len) {
+        return -1;
+    }
+
+    int pos = size - len;
+    if (p_from >= 0 && p_from < pos) {
+        pos = p_from;
+    }
+    const ushort *data = p_text.utf16();
+    bool pair = len > 1;
+    for (; pos >= 0; --pos) {
+        if (isFirstChar(data[pos])
+            && (!pair || isSecondChar(data[pos + 1]))
+            && matchAt(data, size, pos)) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+bool VTextSearcher::matchesAt(const QString &p_text, int p_pos) const
+{
+    int len = m_pattern.size();
+    if (len == 0 || p_pos < 0 || p_pos + len > p_text.size()) {
+        return false;
+    }
+    const ushort *data = p_text.utf16();
+    bool pair = len > 1;
+    return isFirstChar(data[p_pos])
+           && (!pair || isSecondChar(data[p_pos + 1]))
+           && matchAt(data, p_text.size(), p_pos);
+}
+
+void VTextSearcher::findAll(const QString &p_text, QVector<int> &p_offsets) const
+{
+    int len = m_pattern.size();
+    int pos = 0;
+    while ((pos = indexIn(p_text, pos)) != -1) {
+        p_offsets.append(pos);
+        pos += len;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef VTEXTSEARCHER_H
+#define VTEXTSEARCHER_H
+
+#include <QString>
+#include <QVector>
+
+// Search a literal string in a contiguous UTF-16 text, such as a snapshot of
+// a document. Candidates are located by a prefilter on the first two
+// characters, which uses SSE2 when available, and then verified.
+// Case-insensitive search matches the first two characters against all the
+// characters folding to the same, such as 's', 'S' and long s, and uses case
+// folding for the verification. If there are more than three such characters,
+// every position is verified instead.
+class VTextSearcher
+{
+public:
+    VTextSearcher(const QString &p_pattern, bool p_caseSensitive, bool p_wholeWordOnly);
+
+    // Return the position of the first match starting at or after @p_from,
+    // or -1 if not found.
+    int indexIn(const QString &p_text, int p_from = 0) const;
+
+    // Return the position of the last match starting at or before @p_from,
+    // or -1 if not found. -1 for @p_from means the end of @p_text.
+    int lastIndexIn(const QString &p_text, int p_from = -1) const;
+
+    // Find all the non-overlapping matches and append their positions to
+    // @p_offsets.
+    void findAll(const QString &p_text, QVector<int> &p_offsets) const;
+
+    // Whether there is a match starting at @p_pos of @p_text.
+    bool matchesAt(const QString &p_text, int p_pos) const;
+
+    int length() const;
+
+private:
+    // Return the first position in [p_from, p_end) where the first two
+    // characters may match, or -1.
+    int nextCandidate(const ushort *p_data, int p_from, int p_end) const;
+
+    // Whether the pattern matches at @p_pos of @p_data.
+    bool matchAt(const ushort *p_data, int p_size, int p_pos) const;
+
+    // Fill @p_variants with the characters folding to the same as @p_ch.
+    // Return false if there are more than three.
+    static bool caseVariants(QChar p_ch, ushort p_variants[3]);
+
+    bool isFirstChar(ushort p_ch) const;
+    bool isSecondChar(ushort p_ch) const;
+
+    QString m_pattern;
+    // Case folded pattern for case-insensitive verification.
+    QString m_foldedPattern;
+    bool m_caseSensitive;
+    bool m_wholeWordOnly;
+    // Skip the prefilter and verify every position.
+    bool m_fullScan;
+
+    // Case variants of the first two characters.
+    ushort m_first[3];
+    ushort m_second[3];
+};
+
+inline int VTextSearcher::length() const
+{
+    return m_pattern.size();
+}
+
+inline bool VTextSearcher::isFirstChar(ushort p_ch) const
+{
+    return m_fullScan || p_ch == m_first[0] || p_ch == m_first[1] || p_ch == m_first[2];
+}
+
+inline bool VTextSearcher::isSecondChar(ushort p_ch) const
+{
+    return m_fullScan || p_ch == m_second[0] || p_ch == m_second[1] || p_ch == m_second[2];
+}
+
+#endif // VTEXTSEARCHER_H
@@ -15,6 +15,8 @@
 #include <QScreen>
 #include <cmath>
 #include <QLocale>
+#include <QTextDocument>
+#include <QTextBlock>
 
 #include "vconfigmanager.h"
 
@@ -54,6 +56,41 @@ bool VUtils::writeFileToDisk(const QString &filePath, const QString &text)
     return true;
 }
 
+void VUtils::appendUtf8(QByteArray &p_buf, const QString &p_text)
+{
+    const QChar *data = p_text.constData();
+    int size = p_text.size();
+    // At most 3 bytes for each UTF-16 unit.
+    int pos = p_buf.size();
+    p_buf.resize(pos + size * 3);
+    char *out = p_buf.data() + pos;
+    for (int i = 0; i < size; ++i) {
+        uint uc = data[i].unicode();
+        if (uc < 0x80) {
+            *out++ = (char)uc;
+        } else if (uc < 0x800) {
+            *out++ = (char)(0xc0 | (uc >> 6));
+            *out++ = (char)(0x80 | (uc & 0x3f));
+        } else {
+            if (QChar::isHighSurrogate(uc) && i + 1 < size
+                && data[i + 1].isLowSurrogate()) {
+                uc = QChar::surrogateToUcs4(uc, data[++i].unicode());
+                *out++ = (char)(0xf0 | (uc >> 18));
+                *out++ = (char)(0x80 | ((uc >> 12) & 0x3f));
+            } else {
+                if (QChar::isSurrogate(uc)) {
+                    // Unpaired surrogate.
+                    uc = QChar::ReplacementCharacter;
+                }
+                *out++ = (char)(0xe0 | (uc >> 12));
+            }
+            *out++ = (char)(0x80 | ((uc >> 6) & 0x3f));
+            *out++ = (char)(0x80 | (uc & 0x3f));
+        }
+    }
+    p_buf.resize(out - p_buf.constData());
+}
+
 QRgb VUtils::QRgbFromString(const QString &str)
 {
     Q_ASSERT(str.length() == 6);
@@ -381,3 +418,21 @@ QString VUtils::getLocale()
     }
     return locale;
 }
+
+bool VUtils::changedBlocks(const QTextDocument *p_doc, int p_position, int p_charsAdded,
+                           int p_oldBlockCount, QTextBlock &p_firstBlock,
+                           QTextBlock &p_lastBlock, int &p_oldLast)
+{
+    p_firstBlock = p_doc->findBlock(p_position);
+    if (!p_firstBlock.isValid()) {
+        p_firstBlock = p_doc->lastBlock();
+    }
+    p_lastBlock = p_doc->findBlock(p_position + p_charsAdded);
+    if (!p_lastBlock.isValid()) {
+        p_lastBlock = p_doc->lastBlock();
+    }
+
+    int first = p_firstBlock.blockNumber();
+    p_oldLast = p_lastBlock.blockNumber() - (p_doc->blockCount() - p_oldBlockCount);
+    return first <= p_oldBlockCount && p_oldLast >= first - 1 && p_oldLast < p_oldBlockCount;
+}
@@ -11,6 +11,8 @@
 #include "vconstants.h"
 
 class QKeyEvent;
+class QTextDocument;
+class QTextBlock;
 
 #if !defined(V_ASSERT)
     #define V_ASSERT(cond) ((!(cond)) ? qt_assert(#cond, __FILE__, __LINE__) : qt_noop())
@@ -23,6 +25,8 @@ public:
 
     static QString readFileFromDisk(const QString &filePath);
     static bool writeFileToDisk(const QString &filePath, const QString &text);
+    // Encode @p_text in UTF-8 and append it to @p_buf without intermediate copies.
+    static void appendUtf8(QByteArray &p_buf, const QString &p_text);
     // Transform FFFFFF string to QRgb
     static QRgb QRgbFromString(const QString &str);
     static QString generateImageFileName(const QString &path, const QString &title,
@@ -50,6 +54,13 @@ public:
     static bool realEqual(qreal p_a, qreal p_b);
     static QChar keyToChar(int p_key);
     static QString getLocale();
+    // Map a contentsChange() of @p_doc, which had @p_oldBlockCount blocks, to
+    // blocks. Blocks [p_firstBlock, p_oldLast] before the change become
+    // [p_firstBlock, p_lastBlock]. Returns false if the old block count does
+    // not match the change.
+    static bool changedBlocks(const QTextDocument *p_doc, int p_position, int p_charsAdded,
+                              int p_oldBlockCount, QTextBlock &p_firstBlock,
+                              QTextBlock &p_lastBlock, int &p_oldLast);
 
 private:
     // <value, name>
@@ -1,6 +1,7 @@
 #include "vconfigmanager.h"
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QString>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -31,6 +32,12 @@ VConfigManager::~VConfigManager()
     }
 }
 
+QString VConfigManager::getConfigFolder() const
+{
+    Q_ASSERT(userSettings);
+    return QFileInfo(userSettings->fileName()).path();
+}
+
 void VConfigManager::initialize()
 {
     userSettings = new QSettings(QSettings::IniFormat, QSettings::UserScope, orgName, appName);
@@ -59,6 +66,9 @@ void VConfigManager::initialize()
     m_highlightSearchedWord = getConfigFromSettings("global", "highlight_searched_word").toBool();
     m_autoIndent = getConfigFromSettings("global", "auto_indent").toBool();
     m_autoList = getConfigFromSettings("global", "auto_list").toBool();
+    m_undoMemoryBudget = getConfigFromSettings("global", "undo_memory_budget").toInt();
+    m_renderCacheSize = getConfigFromSettings("global", "render_cache_size").toInt();
+    m_previewPoolSize = getConfigFromSettings("global", "preview_pool_size").toInt();
 
     readPredefinedColorsFromSettings();
     curBackgroundColor = getConfigFromSettings("global", "current_background_color").toString();
@@ -90,6 +100,8 @@ void VConfigManager::initialize()
 
     m_enableMathjax = getConfigFromSettings("global", "enable_mathjax").toBool();
 
+    m_livePreview = getConfigFromSettings("global", "live_preview").toBool();
+
     m_webZoomFactor = getConfigFromSettings("global", "web_zoom_factor").toReal();
     if (!isCustomWebZoomFactor()) {
         // Calculate the zoom factor based on DPI.
@@ -44,6 +44,9 @@ public:
     static const QString appName;
     static const QString c_version;
 
+    // Folder containing the user configuration file.
+    QString getConfigFolder() const;
+
     inline QFont getMdEditFont() const;
 
     inline QPalette getMdEditPalette() const;
@@ -128,6 +131,9 @@ public:
     inline bool getEnableMathjax() const;
     inline void setEnableMathjax(bool p_enabled);
 
+    inline bool getLivePreview() const;
+    inline void setLivePreview(bool p_enabled);
+
     inline qreal getWebZoomFactor() const;
     void setWebZoomFactor(qreal p_factor);
     inline bool isCustomWebZoomFactor();
@@ -135,6 +141,12 @@ public:
     inline QString getEditorCurrentLineBackground() const;
     inline QString getEditorCurrentLineVimBackground() const;
 
+    inline int getUndoMemoryBudget() const;
+
+    inline int getRenderCacheSize() const;
+
+    inline int getPreviewPoolSize() const;
+
 private:
     void updateMarkdownEditStyle();
     QVariant getConfigFromSettings(const QString &section, const QString &key);
@@ -205,6 +217,9 @@ private:
     // Enable Mathjax.
     bool m_enableMathjax;
 
+    // Preview Markdown beside the editor in edit mode.
+    bool m_livePreview;
+
     // Zoom factor of the QWebEngineView.
     qreal m_webZoomFactor;
 
@@ -213,6 +228,18 @@ private:
     // Current line background color in editor in Vim mode.
     QString m_editorCurrentLineVimBackground;
 
+    // Memory budget in MB of the undo history of each note. 0 for no limit.
+    // The whole history is cleared once exceeded, except when the last step
+    // alone exceeds it so it could still be undone.
+    int m_undoMemoryBudget;
+
+    // Size limit in MB of the rendered HTML cache of each notebook. 0 to
+    // disable it.
+    int m_renderCacheSize;
+
+    // Max number of idle web views kept for reuse by preview.
+    int m_previewPoolSize;
+
     // The name of the config file in each directory
     static const QString dirConfigFileName;
     // The name of the default configuration file
@@ -588,6 +615,20 @@ inline void VConfigManager::setEnableMathjax(bool p_enabled)
     setConfigToSettings("global", "enable_mathjax", m_enableMathjax);
 }
 
+inline bool VConfigManager::getLivePreview() const
+{
+    return m_livePreview;
+}
+
+inline void VConfigManager::setLivePreview(bool p_enabled)
+{
+    if (m_livePreview == p_enabled) {
+        return;
+    }
+    m_livePreview = p_enabled;
+    setConfigToSettings("global", "live_preview", m_livePreview);
+}
+
 inline qreal VConfigManager::getWebZoomFactor() const
 {
     return m_webZoomFactor;
@@ -609,4 +650,20 @@ inline QString VConfigManager::getEditorCurrentLineVimBackground() const
 {
     return m_editorCurrentLineVimBackground;
 }
+
+inline int VConfigManager::getUndoMemoryBudget() const
+{
+    return m_undoMemoryBudget;
+}
+
+inline int VConfigManager::getRenderCacheSize() const
+{
+    return m_renderCacheSize;
+}
+
+inline int VConfigManager::getPreviewPoolSize() const
+{
+    return m_previewPoolSize;
+}
+
 #endif // VCONFIGMANAGER_H
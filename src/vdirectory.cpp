@@ -6,6 +6,10 @@
 #include "vconfigmanager.h"
 #include "vfile.h"
 #include "utils/vutils.h"
+#include "vnote.h"
+#include "vfilewriter.h"
+
+extern VNote *g_vnote;
 
 VDirectory::VDirectory(VNotebook *p_notebook,
                        const QString &p_name, QObject *p_parent)
@@ -434,6 +438,8 @@ bool VDirectory::rename(const QString &p_name)
     QString parentPath = parentDir->retrivePath();
     QDir dir(parentPath);
     QString name = m_name;
+    // Notes within it may be still being written.
+    g_vnote->getFileWriter()->waitForFinished();
     if (!dir.rename(m_name, p_name)) {
         qWarning() << "fail to rename directory" << m_name << "to" << p_name;
         return false;
@@ -478,6 +484,7 @@ VFile *VDirectory::copyFile(VDirectory *p_destDir, const QString &p_destName,
     }
 
     // Copy the file
+    g_vnote->getFileWriter()->waitForFinished();
     if (!VUtils::copyFile(srcPath, destPath, p_cut)) {
         return NULL;
     }
@@ -0,0 +1,162 @@
+#include "vdocstatistics.h"
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QDebug>
+#include "utils/vutils.h"
+
+// Reading speed of words and CJK characters per minute.
+static const int c_wordsPerMinute = 200;
+static const int c_cjkCharsPerMinute = 400;
+
+static bool isCJK(uint p_ucs4)
+{
+    switch (QChar::script(p_ucs4)) {
+    case QChar::Script_Han:
+    case QChar::Script_Hiragana:
+    case QChar::Script_Katakana:
+    case QChar::Script_Hangul:
+    case QChar::Script_Bopomofo:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+VDocStatistics::VDocStatistics(QTextDocument *p_doc, QObject *p_parent)
+    : QObject(p_parent), m_doc(p_doc)
+{
+    reset();
+    connect(m_doc, &QTextDocument::contentsChange,
+            this, &VDocStatistics::handleContentsChange);
+}
+
+void VDocStatistics::reset()
+{
+    m_blocks.clear();
+    m_blocks.reserve(m_doc->blockCount());
+    m_total = VTextCounts();
+    for (QTextBlock block = m_doc->begin(); block.isValid(); block = block.next()) {
+        VTextCounts counts = countText(block.text());
+        m_blocks.append(counts);
+        m_total += counts;
+    }
+}
+
+void VDocStatistics::handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    Q_UNUSED(p_charsRemoved);
+    QTextBlock firstBlock, lastBlock;
+    int oldLast;
+    bool synced = VUtils::changedBlocks(m_doc, p_position, p_charsAdded, m_blocks.size(),
+                                        firstBlock, lastBlock, oldLast);
+    int first = firstBlock.blockNumber();
+    int last = lastBlock.blockNumber();
+    if (!synced) {
+        qWarning() << "statistics out of sync with the document" << first << oldLast
+                   << m_blocks.size();
+        reset();
+        emit countsChanged();
+        return;
+    }
+
+    for (int i = first; i <= oldLast; ++i) {
+        m_total -= m_blocks[i];
+    }
+    m_blocks.remove(first, oldLast - first + 1);
+
+    QVector<VTextCounts> newCounts;
+    newCounts.reserve(last - first + 1);
+    for (QTextBlock block = firstBlock; block.isValid(); block = block.next()) {
+        VTextCounts counts = countText(block.text());
+        newCounts.append(counts);
+        m_total += counts;
+        if (block == lastBlock) {
+            break;
+        }
+    }
+    m_blocks.insert(first, newCounts.size(), VTextCounts());
+    for (int i = 0; i < newCounts.size(); ++i) {
+        m_blocks[first + i] = newCounts[i];
+    }
+
+    emit countsChanged();
+}
+
+VTextCounts VDocStatistics::countRange(int p_start, int p_end) const
+{
+    VTextCounts counts;
+    QTextBlock firstBlock = m_doc->findBlock(p_start);
+    QTextBlock lastBlock = m_doc->findBlock(p_end);
+    if (!lastBlock.isValid()) {
+        lastBlock = m_doc->lastBlock();
+    }
+    if (!firstBlock.isValid() || p_start >= p_end) {
+        return counts;
+    }
+
+    if (firstBlock == lastBlock) {
+        return countText(firstBlock.text(), p_start - firstBlock.position(),
+                         p_end - firstBlock.position());
+    }
+
+    counts += countText(firstBlock.text(), p_start - firstBlock.position());
+    int last = qMin(lastBlock.blockNumber(), m_blocks.size());
+    for (int i = firstBlock.blockNumber() + 1; i < last; ++i) {
+        counts += m_blocks[i];
+    }
+    counts += countText(lastBlock.text(), 0, p_end - lastBlock.position());
+    return counts;
+}
+
+int VDocStatistics::readingMinutes(const VTextCounts &p_counts)
+{
+    int words = p_counts.m_words - p_counts.m_cjkChars;
+    int minutes = (words + c_wordsPerMinute - 1) / c_wordsPerMinute
+                  + (p_counts.m_cjkChars + c_cjkCharsPerMinute - 1) / c_cjkCharsPerMinute;
+    return minutes;
+}
+
+VTextCounts VDocStatistics::countText(const QString &p_text, int p_start, int p_end)
+{
+    VTextCounts counts;
+    if (p_end < 0 || p_end > p_text.size()) {
+        p_end = p_text.size();
+    }
+    bool inWord = false;
+    bool hasObject = false;
+    bool hasText = false;
+    for (int i = qMax(p_start, 0); i < p_end; ++i) {
+        QChar ch = p_text.at(i);
+        uint ucs4 = ch.unicode();
+        if (ch.isHighSurrogate() && i + 1 < p_end && p_text.at(i + 1).isLowSurrogate()) {
+            ucs4 = QChar::surrogateToUcs4(ch, p_text.at(i + 1));
+            ++i;
+        } else if (ch == QChar::ObjectReplacementCharacter) {
+            // Image preview.
+            hasObject = true;
+            inWord = false;
+            continue;
+        }
+
+        ++counts.m_chars;
+        if (!ch.isSpace()) {
+            hasText = true;
+        }
+        if (isCJK(ucs4)) {
+            ++counts.m_cjkChars;
+            ++counts.m_words;
+            inWord = false;
+        } else if (QChar::isLetterOrNumber(ucs4) || ucs4 == '_') {
+            if (!inWord) {
+                ++counts.m_words;
+                inWord = true;
+            }
+        } else if (ucs4 != '\'' || !inWord) {
+            // Apostrophe within a word does not break it.
+            inWord = false;
+        }
+    }
+    counts.m_lines = (hasObject && !hasText) ? 0 : 1;
+    return counts;
+}
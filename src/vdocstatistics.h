@@ -0,0 +1,86 @@
+#ifndef VDOCSTATISTICS_H
+#define VDOCSTATISTICS_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QTextDocument;
+
+struct VTextCounts
+{
+    VTextCounts() : m_lines(0), m_words(0), m_chars(0), m_cjkChars(0)
+    {
+    }
+
+    VTextCounts &operator+=(const VTextCounts &p_other)
+    {
+        m_lines += p_other.m_lines;
+        m_words += p_other.m_words;
+        m_chars += p_other.m_chars;
+        m_cjkChars += p_other.m_cjkChars;
+        return *this;
+    }
+
+    VTextCounts &operator-=(const VTextCounts &p_other)
+    {
+        m_lines -= p_other.m_lines;
+        m_words -= p_other.m_words;
+        m_chars -= p_other.m_chars;
+        m_cjkChars -= p_other.m_cjkChars;
+        return *this;
+    }
+
+    // Blocks holding only objects, such as image previews, are not lines.
+    int m_lines;
+    // Each CJK character counts as one word.
+    int m_words;
+    // Characters excluding line breaks.
+    int m_chars;
+    int m_cjkChars;
+};
+
+// Word and character counts of a QTextDocument, kept per block and updated
+// from the changed blocks only.
+class VDocStatistics : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VDocStatistics(QTextDocument *p_doc, QObject *p_parent = 0);
+
+    // Counts of the whole document.
+    inline const VTextCounts &getTotal() const;
+
+    // Counts of [p_start, p_end) of the document. Blocks fully inside the
+    // range use their cached counts.
+    VTextCounts countRange(int p_start, int p_end) const;
+
+    // Estimated reading time in minutes of @p_counts.
+    static int readingMinutes(const VTextCounts &p_counts);
+
+    // Count [p_start, p_end) of @p_text of one block. -1 for @p_end means
+    // the end.
+    static VTextCounts countText(const QString &p_text, int p_start = 0, int p_end = -1);
+
+signals:
+    void countsChanged();
+
+private slots:
+    void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+
+private:
+    // Count all the blocks.
+    void reset();
+
+    QTextDocument *m_doc;
+    // Indexed by block number.
+    QVector<VTextCounts> m_blocks;
+    VTextCounts m_total;
+};
+
+inline const VTextCounts &VDocStatistics::getTotal() const
+{
+    return m_total;
+}
+
+#endif // VDOCSTATISTICS_H
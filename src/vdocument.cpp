@@ -1,15 +1,111 @@
 #include "vdocument.h"
 #include "vfile.h"
 #include <QDebug>
+#include <QRegExp>
+
+// Min size in characters of each chunk of the content sent to the HTML side.
+static const int c_textChunkSize = 256 * 1024;
+
+// Size of @p_text in UTF-8, without encoding it.
+static qint64 utf8Size(const QString &p_text)
+{
+    qint64 size = 0;
+    const QChar *data = p_text.constData();
+    int len = p_text.size();
+    for (int i = 0; i < len; ++i) {
+        ushort ch = data[i].unicode();
+        if (ch < 0x80) {
+            size += 1;
+        } else if (ch < 0x800) {
+            size += 2;
+        } else if (QChar::isHighSurrogate(ch) && i + 1 < len
+                   && QChar::isLowSurrogate(data[i + 1].unicode())) {
+            size += 4;
+            ++i;
+        } else {
+            size += 3;
+        }
+    }
+    return size;
+}
 
 VDocument::VDocument(const VFile *v_file, QObject *p_parent)
-    : QObject(p_parent), m_file(v_file)
+    : QObject(p_parent), m_textId(0), m_textChunkIndex(0), m_textBytes(0), m_textMs(0),
+      m_file(v_file)
 {
 }
 
 void VDocument::updateText()
 {
-    emit textChanged(m_file->getContent());
+    // Drop the chunks left of the last transfer.
+    ++m_textId;
+    m_textChunks = splitText(m_file->getContent(), c_textChunkSize);
+    m_textChunkIndex = 0;
+    m_textBytes = 0;
+    m_textMs = 0;
+    sendTextChunk();
+}
+
+void VDocument::sendTextChunk()
+{
+    const QString &chunk = m_textChunks[m_textChunkIndex];
+    // The channel carries the chunk as JSON in UTF-8.
+    m_textBytes += utf8Size(chunk);
+    m_textTimer.start();
+    emit textChunkReady(m_textId, m_textChunkIndex, m_textChunks.size(), chunk);
+}
+
+void VDocument::textChunkReceived(int p_id, int p_index)
+{
+    if (p_id != m_textId || p_index != m_textChunkIndex) {
+        return;
+    }
+    m_textMs += m_textTimer.elapsed();
+    if (++m_textChunkIndex < m_textChunks.size()) {
+        sendTextChunk();
+        return;
+    }
+
+    qDebug() << "text sent" << m_textBytes << "UTF-8 bytes in" << m_textChunks.size()
+             << "chunks" << m_textMs << "ms on channel";
+    m_textChunks.clear();
+}
+
+QStringList VDocument::splitText(const QString &p_text, int p_chunkSize)
+{
+    QStringList chunks;
+    if (p_text.size() <= p_chunkSize) {
+        chunks.append(p_text);
+        return chunks;
+    }
+
+    // A blank line outside code blocks followed by a line not belonging to
+    // the previous block, such as lists, blockquotes and indented code.
+    QRegExp fenceExp("^ {0,3}(```|~~~)");
+    QRegExp newBlockExp("^[^\\s\\-\\*\\+>\\d]");
+    bool inFence = false;
+    bool blank = false;
+    int start = 0;
+    int pos = 0;
+    while (pos < p_text.size()) {
+        int end = p_text.indexOf('\n', pos);
+        if (end == -1) {
+            end = p_text.size();
+        }
+        QString line = p_text.mid(pos, end - pos);
+        if (blank && !inFence && pos - start >= p_chunkSize
+            && newBlockExp.indexIn(line) == 0) {
+            chunks.append(p_text.mid(start, pos - start));
+            start = pos;
+        }
+        if (fenceExp.indexIn(line) == 0) {
+            inFence = !inFence;
+        }
+        blank = line.trimmed().isEmpty();
+        pos = end + 1;
+    }
+    chunks.append(p_text.mid(start));
+    return chunks;
 }
 
 void VDocument::setToc(const QString &toc)
@@ -28,6 +124,8 @@ QString VDocument::getToc()
 
 void VDocument::scrollToAnchor(const QString &anchor)
 {
+    // Kept for the page which is not loaded yet.
+    m_anchor = anchor;
     emit requestScrollToAnchor(anchor);
 }
 
@@ -46,9 +144,59 @@ void VDocument::setHtml(const QString &html)
         return;
     }
     m_html = html;
+    m_fragmentKeys.clear();
+    m_fragments.clear();
     emit htmlChanged(m_html);
 }
 
+void VDocument::patchHtml(const QString &html, const QStringList &p_blocks)
+{
+    QStringList keys;
+    QHash<QString, QString> fragments;
+    QVariantMap newFragments;
+    for (int i = 0; i < p_blocks.size(); ++i) {
+        const QString &block = p_blocks[i];
+        // Unchanged blocks keep their keys. A key never maps to different
+        // HTML, even on hash collision.
+        uint hash = qHash(block);
+        QString key;
+        for (int nr = 0; ; ++nr) {
+            key = QString("%1_%2").arg(hash).arg(nr);
+            if (fragments.contains(key)) {
+                continue;
+            }
+            auto it = m_fragments.find(key);
+            if (it == m_fragments.end() || it.value() == block) {
+                break;
+            }
+        }
+        keys.append(key);
+        fragments.insert(key, block);
+        if (!m_fragments.contains(key)) {
+            newFragments.insert(key, block);
+        }
+    }
+
+    m_html = html;
+    m_fragmentKeys = keys;
+    m_fragments = fragments;
+    emit htmlPatched(m_fragmentKeys, newFragments);
+}
+
+void VDocument::requestAllFragments()
+{
+    QVariantMap fragments;
+    for (auto it = m_fragments.constBegin(); it != m_fragments.constEnd(); ++it) {
+        fragments.insert(it.key(), it.value());
+    }
+    emit htmlPatched(m_fragmentKeys, fragments);
+}
+
+const QString &VDocument::getHtml() const
+{
+    return m_html;
+}
+
 void VDocument::setLog(const QString &p_log)
 {
     qDebug() << "JS:" << p_log;
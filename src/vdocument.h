@@ -3,21 +3,30 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVariantMap>
+#include <QElapsedTimer>
 
 class VFile;
 
 class VDocument : public QObject
 {
     Q_OBJECT
-    Q_PROPERTY(QString text MEMBER m_text NOTIFY textChanged)
     Q_PROPERTY(QString toc MEMBER m_toc NOTIFY tocChanged)
     Q_PROPERTY(QString html MEMBER m_html NOTIFY htmlChanged)
+    // The HTML side scrolls to it once loaded.
+    Q_PROPERTY(QString anchor MEMBER m_anchor NOTIFY requestScrollToAnchor)
 
 public:
     VDocument(const VFile *p_file, QObject *p_parent = 0);
     QString getToc();
     void scrollToAnchor(const QString &anchor);
     void setHtml(const QString &html);
+    const QString &getHtml() const;
+    // Update the HTML side to @html by patching the changed top-level blocks
+    // @p_blocks only.
+    void patchHtml(const QString &html, const QStringList &p_blocks);
 
 public slots:
     // Will be called in the HTML side
@@ -25,27 +34,59 @@ public slots:
     void setHeader(const QString &anchor);
     void setLog(const QString &p_log);
     void keyPressEvent(int p_key, bool p_ctrl, bool p_shift);
+    // Send the content to the HTML side in chunks.
     void updateText();
+    // The HTML side has received chunk @p_index of transfer @p_id. The next
+    // chunk is sent then.
+    void textChunkReceived(int p_id, int p_index);
+    // Send all the blocks of the last patch again, such as when the HTML side
+    // has lost them.
+    void requestAllFragments();
 
 signals:
-    void textChanged(const QString &text);
     void tocChanged(const QString &toc);
     void requestScrollToAnchor(const QString &anchor);
     void headerChanged(const QString &anchor);
     void htmlChanged(const QString &html);
+    // Chunk @p_index of @p_count chunks of the content. @p_id identifies the
+    // transfer and increases with each updateText().
+    void textChunkReady(int p_id, int p_index, int p_count, const QString &p_chunk);
+    // @p_keys are the keys of the blocks in order. @p_fragments maps the keys
+    // not sent before to the HTML of the blocks.
+    void htmlPatched(const QStringList &p_keys, const QVariantMap &p_fragments);
     void logChanged(const QString &p_log);
     void keyPressed(int p_key, bool p_ctrl, bool p_shift);
 
 private:
+    void sendTextChunk();
+
+    // Split @p_text at blank lines into chunks of at least @p_chunkSize
+    // characters, so that each chunk could be rendered alone mostly.
+    static QStringList splitText(const QString &p_text, int p_chunkSize);
+
     QString m_toc;
     QString m_header;
-
-    // m_text does NOT contain actual content.
-    QString m_text;
+    // Last anchor requested to scroll to.
+    QString m_anchor;
 
     // When using Hoedown, m_html will contain the html content.
     QString m_html;
 
+    // Keys and HTML of the blocks of the last patch.
+    QStringList m_fragmentKeys;
+    QHash<QString, QString> m_fragments;
+
+    // Chunks of the content being sent.
+    QStringList m_textChunks;
+    int m_textId;
+    int m_textChunkIndex;
+    // Time the current chunk was sent.
+    QElapsedTimer m_textTimer;
+    // UTF-8 bytes of the chunks and milliseconds spent on the channel of
+    // current transfer.
+    qint64 m_textBytes;
+    qint64 m_textMs;
+
     const VFile *m_file;
 };
 
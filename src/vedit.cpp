@@ -1,22 +1,34 @@
 #include <QtWidgets>
 #include <QVector>
 #include <QDebug>
+#include <algorithm>
+#include <QRegularExpression>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
 #include "vedit.h"
 #include "vnote.h"
 #include "vconfigmanager.h"
 #include "vtoc.h"
 #include "utils/vutils.h"
+#include "utils/vtextsearcher.h"
 #include "veditoperations.h"
 #include "dialog/vfindreplacedialog.h"
 
 extern VConfigManager vconfig;
 extern VNote *g_vnote;
 
+// Estimated bytes of one undo command of QTextDocument.
+static const int c_undoCommandSize = 64;
+
 VEdit::VEdit(VFile *p_file, QWidget *p_parent)
-    : QTextEdit(p_parent), m_file(p_file), m_editOps(NULL)
+    : VEditBase(p_parent), m_file(p_file), m_editOps(NULL), m_countOptions(0),
+      m_countRevision(-1), m_peekStartPos(0), m_peekLastPos(0), m_peekOptions(0),
+      m_peekRevision(-1), m_peekContentRevision(-1), m_undoMemory(0), m_lastUndoSteps(0),
+      m_undoCompactPending(false), m_undoCompactSuspended(false)
 {
     const int labelTimerInterval = 500;
     const int selectedWordTimerInterval = 500;
+    const int highlightUpdateInterval = 300;
     const int labelSize = 64;
 
     m_cursorLineColor = QColor(g_vnote->getColorFromPalette("Indigo1"));
@@ -39,12 +51,34 @@ VEdit::VEdit(VFile *p_file, QWidget *p_parent)
     connect(m_selectedWordTimer, &QTimer::timeout,
             this, &VEdit::highlightSelectedWord);
 
+    m_highlightUpdateTimer = new QTimer(this);
+    m_highlightUpdateTimer->setSingleShot(true);
+    m_highlightUpdateTimer->setInterval(highlightUpdateInterval);
+    connect(m_highlightUpdateTimer, &QTimer::timeout,
+            this, &VEdit::updateVisibleHighlights);
+
     connect(document(), &QTextDocument::modificationChanged,
             (VFile *)m_file, &VFile::setModified);
 
+    m_countWatcher = new QFutureWatcher<int>(this);
+    connect(m_countWatcher, &QFutureWatcher<int>::finished,
+            this, &VEdit::handleCountFinished);
+
     m_extraSelections.resize((int)SelectionId::MaxSelection);
+    m_highlightTexts.resize((int)SelectionId::MaxSelection);
     updateFontAndPalette();
 
+    connect(verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &VEdit::updateVisibleHighlights);
+    connect(document(), &QTextDocument::contentsChanged,
+            this, &VEdit::invalidateHighlightRanges);
+    connect(document(), &QTextDocument::contentsChanged,
+            this, &VEdit::releaseSearchSnapshot);
+    connect(document(), &QTextDocument::undoCommandAdded,
+            this, &VEdit::handleUndoCommandAdded);
+    connect(document(), &QTextDocument::contentsChange,
+            this, &VEdit::handleUndoContentsChange);
+
     connect(this, &VEdit::cursorPositionChanged,
             this, &VEdit::highlightCurrentLine);
     connect(this, &VEdit::selectionChanged,
@@ -77,13 +111,21 @@ void VEdit::saveFile()
     if (!document()->isModified()) {
         return;
     }
+#ifdef VNOTE_PLAIN_TEXT_EDITOR
+    m_file->setContent(document()->toHtml());
+#else
     m_file->setContent(toHtml());
+#endif
     document()->setModified(false);
 }
 
 void VEdit::reloadFile()
 {
+#ifdef VNOTE_PLAIN_TEXT_EDITOR
+    document()->setHtml(m_file->getContent());
+#else
     setHtml(m_file->getContent());
+#endif
     setModified(false);
 }
 
@@ -93,7 +135,7 @@ void VEdit::scrollToLine(int p_lineNumber)
 
     // Move the cursor to the end first
     moveCursor(QTextCursor::End);
-    QTextCursor cursor(document()->findBlockByLineNumber(p_lineNumber));
+    QTextCursor cursor(document()->findBlockByNumber(p_lineNumber));
     cursor.movePosition(QTextCursor::EndOfBlock);
     setTextCursor(cursor);
 }
@@ -120,136 +162,261 @@ void VEdit::insertImage()
 
 bool VEdit::peekText(const QString &p_text, uint p_options)
 {
-    static int startPos = textCursor().selectionStart();
-    static int lastPos = startPos;
-    bool found = false;
-
+    // The document may have been changed since last peek.
+    m_peekStartPos = qMin(m_peekStartPos, document()->characterCount() - 1);
     if (p_text.isEmpty()) {
         // Clear previous selection
         QTextCursor cursor = textCursor();
         cursor.clearSelection();
-        cursor.setPosition(startPos);
+        cursor.setPosition(m_peekStartPos);
+        setTextCursor(cursor);
+        clearPeekCandidates();
+        return false;
+    }
+
+    QTextCursor cursor = textCursor();
+    int curPos = cursor.selectionStart();
+    if (curPos != m_peekLastPos) {
+        // Cursor has been moved. Just start at current potition.
+        m_peekStartPos = curPos;
+        m_peekLastPos = curPos;
+    }
+
+    bool found = false;
+    if (p_options & FindOption::RegularExpression) {
+        // A longer regular expression may match what a shorter one does not,
+        // so always do a full search. Keep the snapshot.
+        m_peekText.clear();
+        m_peekCandidates.clear();
+        cursor.setPosition(m_peekStartPos);
         setTextCursor(cursor);
+        bool wrapped = false;
+        found = findTextHelper(p_text, p_options, true, wrapped);
     } else {
-        QTextCursor cursor = textCursor();
-        int curPos = cursor.selectionStart();
-        if (curPos != lastPos) {
-            // Cursor has been moved. Just start at current potition.
-            startPos = curPos;
-            lastPos = curPos;
-        } else {
-            cursor.setPosition(startPos);
-            setTextCursor(cursor);
+        updatePeekCandidates(p_text, p_options);
+        VTextSearcher searcher(p_text, p_options & FindOption::CaseSensitive,
+                               p_options & FindOption::WholeWordOnly);
+        // Candidates do not take whole word into account.
+        int idx = std::lower_bound(m_peekCandidates.begin(), m_peekCandidates.end(),
+                                   m_peekStartPos) - m_peekCandidates.begin();
+        int nrCandidates = m_peekCandidates.size();
+        for (int i = 0; i < nrCandidates; ++i) {
+            int pos = m_peekCandidates[(idx + i) % nrCandidates];
+            if (searcher.matchesAt(m_peekContent, pos)) {
+                cursor.setPosition(pos);
+                cursor.setPosition(pos + searcher.length(), QTextCursor::KeepAnchor);
+                found = true;
+                break;
+            }
         }
+        if (!found) {
+            cursor.setPosition(m_peekStartPos);
+        }
+        setTextCursor(cursor);
     }
-    bool wrapped = false;
-    found = findTextHelper(p_text, p_options, true, wrapped);
+
     if (found) {
-        lastPos = textCursor().selectionStart();
-        found = true;
+        m_peekLastPos = textCursor().selectionStart();
     }
     return found;
 }
 
-// Use QTextEdit::find() instead of QTextDocument::find() because the later has
-// bugs in searching backward.
+void VEdit::updatePeekCandidates(const QString &p_text, uint p_options)
+{
+    bool caseSensitive = p_options & FindOption::CaseSensitive;
+    int revision = document()->revision();
+    // Matches of an extended text are a subset of the matches of the
+    // previous text, if the document and options are not changed.
+    bool narrow = !m_peekText.isEmpty()
+                  && p_text.startsWith(m_peekText)
+                  && p_options == m_peekOptions
+                  && revision == m_peekRevision;
+    if (narrow && p_text.size() == m_peekText.size()) {
+        return;
+    }
+
+    VTextSearcher searcher(p_text, caseSensitive, false);
+    if (narrow) {
+        int nrCandidates = 0;
+        for (int i = 0; i < m_peekCandidates.size(); ++i) {
+            int pos = m_peekCandidates[i];
+            if (searcher.matchesAt(m_peekContent, pos)) {
+                m_peekCandidates[nrCandidates++] = pos;
+            }
+        }
+        m_peekCandidates.resize(nrCandidates);
+    } else {
+        searchSnapshot();
+        m_peekCandidates.clear();
+        int pos = 0;
+        while ((pos = searcher.indexIn(m_peekContent, pos)) != -1) {
+            m_peekCandidates.append(pos);
+            ++pos;
+        }
+    }
+
+    qDebug() << "peek" << p_text << (narrow ? "narrowed to" : "scanned")
+             << m_peekCandidates.size() << "candidates";
+    m_peekText = p_text;
+    m_peekOptions = p_options;
+    m_peekRevision = revision;
+}
+
+void VEdit::clearPeekCandidates()
+{
+    m_peekText.clear();
+    m_peekContent.clear();
+    m_peekCandidates.clear();
+    m_peekRevision = -1;
+    m_peekContentRevision = -1;
+}
+
+const QString &VEdit::searchSnapshot()
+{
+    int revision = document()->revision();
+    if (revision != m_peekContentRevision) {
+        m_peekContent = toPlainText();
+        m_peekContentRevision = revision;
+    }
+    return m_peekContent;
+}
+
+void VEdit::releaseSearchSnapshot()
+{
+    // Format changes do not move the revision.
+    if (m_peekContentRevision != -1 && document()->revision() != m_peekContentRevision) {
+        m_peekContent.clear();
+        m_peekContentRevision = -1;
+    }
+}
+
 bool VEdit::findTextHelper(const QString &p_text, uint p_options,
                            bool p_forward, bool &p_wrapped)
 {
     p_wrapped = false;
-    bool found = false;
 
-    // Options
-    QTextDocument::FindFlags findFlags;
-    bool caseSensitive = false;
-    if (p_options & FindOption::CaseSensitive) {
-        findFlags |= QTextDocument::FindCaseSensitively;
-        caseSensitive = true;
+    // Search in a snapshot of the document, shared by the searches until the
+    // document changes.
+    const QString &content = searchSnapshot();
+    QTextCursor cursor = textCursor();
+    int length = 0;
+    int pos = -1;
+    if (p_forward) {
+        pos = findInText(content, p_text, p_options, cursor.selectionEnd(), true, length);
+    } else if (cursor.selectionStart() > 0) {
+        pos = findInText(content, p_text, p_options, cursor.selectionStart() - 1,
+                         false, length);
     }
-    if (p_options & FindOption::WholeWordOnly) {
-        findFlags |= QTextDocument::FindWholeWords;
+    if (pos == -1) {
+        // Wrap to the other end of the document to search again.
+        p_wrapped = true;
+        pos = findInText(content, p_text, p_options, p_forward ? 0 : -1,
+                         p_forward, length);
     }
-    if (!p_forward) {
-        findFlags |= QTextDocument::FindBackward;
+    if (pos == -1) {
+        return false;
     }
-    // Use regular expression
-    bool useRegExp = false;
-    QRegExp exp;
-    if (p_options & FindOption::RegularExpression) {
-        useRegExp = true;
-        exp = QRegExp(p_text,
-                      caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    cursor.setPosition(pos);
+    cursor.setPosition(pos + length, QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+    return true;
+}
+
+int VEdit::findInText(const QString &p_content, const QString &p_text, uint p_options,
+                      int p_from, bool p_forward, int &p_length)
+{
+    bool caseSensitive = p_options & FindOption::CaseSensitive;
+    bool wholeWord = p_options & FindOption::WholeWordOnly;
+    if (!(p_options & FindOption::RegularExpression)) {
+        VTextSearcher searcher(p_text, caseSensitive, wholeWord);
+        p_length = searcher.length();
+        return p_forward ? searcher.indexIn(p_content, p_from)
+                         : searcher.lastIndexIn(p_content, p_from);
     }
-    QTextCursor cursor = textCursor();
-    while (!found) {
-        if (useRegExp) {
-            found = find(exp, findFlags);
-        } else {
-            found = find(p_text, findFlags);
+
+    const QRegularExpression &exp = cachedRegExp(p_text, p_options);
+    if (!exp.isValid()) {
+        return -1;
+    }
+    if (p_forward) {
+        return findRegExp(p_content, exp, wholeWord, p_from, p_content.size(), p_length);
+    }
+
+    // Search backward line by line, so the search is within the lines before
+    // @p_from only.
+    if (p_from < 0 || p_from >= p_content.size()) {
+        p_from = p_content.size();
+    }
+    while (p_from >= 0) {
+        int lineStart = p_from > 0 ? p_content.lastIndexOf('\n', p_from - 1) + 1 : 0;
+        int lineEnd = p_content.indexOf('\n', p_from);
+        if (lineEnd == -1) {
+            lineEnd = p_content.size();
         }
-        if (p_wrapped) {
-            if (!found) {
-                setTextCursor(cursor);
-            }
-            break;
+        int pos = -1;
+        int start = lineStart;
+        int length = 0;
+        while (start <= p_from
+               && (start = findRegExp(p_content, exp, wholeWord, start, lineEnd, length)) != -1
+               && start <= p_from) {
+            pos = start;
+            p_length = length;
+            start += length;
         }
-        if (!found) {
-            // Wrap to the other end of the document to search again.
-            p_wrapped = true;
-            QTextCursor wrapCursor = textCursor();
-            wrapCursor.clearSelection();
-            if (p_forward) {
-                wrapCursor.movePosition(QTextCursor::Start, QTextCursor::MoveAnchor);
-            } else {
-                wrapCursor.movePosition(QTextCursor::End, QTextCursor::MoveAnchor);
-            }
-            setTextCursor(wrapCursor);
+        if (pos != -1) {
+            return pos;
         }
+        p_from = lineStart - 1;
     }
-    return found;
+    return -1;
 }
 
-QList<QTextCursor> VEdit::findTextAll(const QString &p_text, uint p_options)
+int VEdit::findRegExp(const QString &p_content, const QRegularExpression &p_exp,
+                      bool p_wholeWord, int p_from, int p_end, int &p_length)
 {
-    QList<QTextCursor> results;
-    if (p_text.isEmpty()) {
-        return results;
-    }
-    // Options
-    QTextDocument::FindFlags findFlags;
-    bool caseSensitive = false;
-    if (p_options & FindOption::CaseSensitive) {
-        findFlags |= QTextDocument::FindCaseSensitively;
-        caseSensitive = true;
-    }
-    if (p_options & FindOption::WholeWordOnly) {
-        findFlags |= QTextDocument::FindWholeWords;
+    // Matching stops at @p_end.
+    QStringRef subject = p_content.leftRef(p_end);
+    QRegularExpressionMatchIterator it = p_exp.globalMatch(subject, p_from);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        int start = match.capturedStart();
+        int length = match.capturedLength();
+        // Like QTextDocument::find(), a match could not cross blocks.
+        if (length == 0
+            || p_content.midRef(start, length).contains('\n')
+            || (p_wholeWord && !isWholeWord(p_content, start, start + length))) {
+            continue;
+        }
+        p_length = length;
+        return start;
     }
-    // Use regular expression
-    bool useRegExp = false;
-    QRegExp exp;
+    return -1;
+}
+
+QRegularExpression VEdit::regExpForOptions(const QString &p_text, uint p_options)
+{
     if (p_options & FindOption::RegularExpression) {
-        useRegExp = true;
-        exp = QRegExp(p_text,
-                      caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        return cachedRegExp(p_text, p_options);
     }
-    int startPos = 0;
-    QTextCursor cursor;
-    QTextDocument *doc = document();
-    while (true) {
-        if (useRegExp) {
-            cursor = doc->find(exp, startPos, findFlags);
-        } else {
-            cursor = doc->find(p_text, startPos, findFlags);
-        }
-        if (cursor.isNull()) {
-            break;
+    return QRegularExpression();
+}
+
+const QRegularExpression &VEdit::cachedRegExp(const QString &p_text, uint p_options)
+{
+    QRegularExpression::PatternOptions opts = QRegularExpression::MultilineOption;
+    if (!(p_options & FindOption::CaseSensitive)) {
+        opts |= QRegularExpression::CaseInsensitiveOption;
+    }
+    if (m_regExp.pattern() != p_text || m_regExp.patternOptions() != opts) {
+        m_regExp = QRegularExpression(p_text, opts);
+        if (m_regExp.isValid()) {
+            // Compile and JIT it now instead of on the first several matches.
+            m_regExp.optimize();
         } else {
-            results.append(cursor);
-            startPos = cursor.selectionEnd();
+            qWarning() << "invalid regular expression" << p_text << m_regExp.errorString();
         }
     }
-    return results;
+    return m_regExp;
 }
 
 bool VEdit::findText(const QString &p_text, uint p_options, bool p_forward)
@@ -267,9 +434,11 @@ bool VEdit::findText(const QString &p_text, uint p_options, bool p_forward)
                 showWrapLabel();
             }
             highlightSearchedWord(p_text, p_options);
+            countTextAll(p_text, p_options);
         } else {
             // Simply clear previous highlight.
             highlightSearchedWord("", p_options);
+            emit textCountUpdated(p_text, p_options, 0);
         }
     }
     qDebug() << "findText" << p_text << p_options << p_forward
@@ -310,38 +479,131 @@ void VEdit::replaceText(const QString &p_text, uint p_options,
     }
 }
 
-void VEdit::replaceTextAll(const QString &p_text, uint p_options,
-                           const QString &p_replaceText)
+int VEdit::replaceTextAll(const QString &p_text, uint p_options,
+                          const QString &p_replaceText)
 {
-    // Replace from the start to the end and resotre the cursor.
+    if (p_text.isEmpty()) {
+        return 0;
+    }
+    // Collect all the matches within a snapshot of the document in one scan.
+    QVector<QPair<int, int> > ranges;
+    QVector<QString> replaceTexts;
+    bool expandCaptures = (p_options & FindOption::RegularExpression)
+                          && p_replaceText.contains('\\');
+    {
+        QString content = toPlainText();
+        findAllInText(content, p_text, p_options, regExpForOptions(p_text, p_options),
+                      ranges, p_replaceText, expandCaptures ? &replaceTexts : NULL);
+    }
+    int nrReplaces = ranges.size();
+    if (nrReplaces == 0) {
+        qDebug() << "replace all" << 0 << "occurences";
+        return 0;
+    }
+
+    // Apply the replacements from the end so that the ranges before
+    // are not shifted. Do not repaint until all are done.
     QTextCursor cursor = textCursor();
-    int nrReplaces = 0;
-    QTextCursor tmpCursor = cursor;
-    tmpCursor.setPosition(0);
-    setTextCursor(tmpCursor);
-    while (true) {
-        bool wrapped = false;
-        bool found = findTextHelper(p_text, p_options, true, wrapped);
-        if (!found) {
-            break;
-        } else {
-            if (wrapped) {
-                // Wrap back.
-                break;
-            }
-            nrReplaces++;
-            tmpCursor = textCursor();
-            tmpCursor.beginEditBlock();
-            tmpCursor.removeSelectedText();
-            tmpCursor.insertText(p_replaceText);
-            tmpCursor.endEditBlock();
-            setTextCursor(tmpCursor);
-        }
+    viewport()->setUpdatesEnabled(false);
+    QTextCursor editCursor(document());
+    editCursor.beginEditBlock();
+    for (int i = nrReplaces - 1; i >= 0; --i) {
+        const QPair<int, int> &range = ranges[i];
+        editCursor.setPosition(range.first);
+        editCursor.setPosition(range.first + range.second, QTextCursor::KeepAnchor);
+        editCursor.insertText(expandCaptures ? replaceTexts[i] : p_replaceText);
     }
+    editCursor.endEditBlock();
+    viewport()->setUpdatesEnabled(true);
+
     // Restore cursor position.
     cursor.clearSelection();
     setTextCursor(cursor);
     qDebug() << "replace all" << nrReplaces << "occurences";
+    return nrReplaces;
+}
+
+void VEdit::findAllInText(const QString &p_content, const QString &p_text,
+                          uint p_options, const QRegularExpression &p_exp,
+                          QVector<QPair<int, int> > &p_ranges,
+                          const QString &p_replaceText,
+                          QVector<QString> *p_replaceTexts)
+{
+    bool caseSensitive = p_options & FindOption::CaseSensitive;
+    bool wholeWord = p_options & FindOption::WholeWordOnly;
+    if (p_options & FindOption::RegularExpression) {
+        if (!p_exp.isValid()) {
+            return;
+        }
+        QRegularExpressionMatchIterator it = p_exp.globalMatch(p_content);
+        while (it.hasNext()) {
+            QRegularExpressionMatch match = it.next();
+            int start = match.capturedStart();
+            int length = match.capturedLength();
+            // Like QTextDocument::find(), a match could not cross blocks.
+            if (length == 0
+                || p_content.midRef(start, length).contains('\n')
+                || (wholeWord && !isWholeWord(p_content, start, start + length))) {
+                continue;
+            }
+            p_ranges.append(QPair<int, int>(start, length));
+            if (p_replaceTexts) {
+                p_replaceTexts->append(expandCapturedTexts(p_replaceText, match));
+            }
+        }
+    } else {
+        VTextSearcher searcher(p_text, caseSensitive, wholeWord);
+        QVector<int> offsets;
+        searcher.findAll(p_content, offsets);
+        int length = searcher.length();
+        p_ranges.reserve(p_ranges.size() + offsets.size());
+        for (int i = 0; i < offsets.size(); ++i) {
+            p_ranges.append(QPair<int, int>(offsets[i], length));
+        }
+    }
+}
+
+bool VEdit::isWholeWord(const QString &p_text, int p_start, int p_end)
+{
+    // The same rule as QTextDocument::FindWholeWords.
+    if (p_start > 0 && p_text.at(p_start - 1).isLetterOrNumber()) {
+        return false;
+    }
+    if (p_end < p_text.size() && p_text.at(p_end).isLetterOrNumber()) {
+        return false;
+    }
+    return true;
+}
+
+QString VEdit::expandCapturedTexts(const QString &p_replaceText,
+                                   const QRegularExpressionMatch &p_match)
+{
+    QString text;
+    int size = p_replaceText.size();
+    int lastIdx = p_match.lastCapturedIndex();
+    text.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        QChar ch = p_replaceText.at(i);
+        if (ch == '\\' && i + 1 < size && p_replaceText.at(i + 1).isDigit()) {
+            int no = p_replaceText.at(i + 1).digitValue();
+            int len = 1;
+            // Try two digits.
+            if (i + 2 < size && p_replaceText.at(i + 2).isDigit()) {
+                int no2 = no * 10 + p_replaceText.at(i + 2).digitValue();
+                if (no2 <= lastIdx) {
+                    no = no2;
+                    len = 2;
+                }
+            }
+            if (no <= lastIdx) {
+                text.append(p_match.captured(no));
+                i += len;
+                continue;
+            }
+        }
+        text.append(ch);
+    }
+    return text;
 }
 
 void VEdit::showWrapLabel()
@@ -410,7 +672,7 @@ void VEdit::highlightCurrentLine()
 
 void VEdit::setReadOnly(bool p_ro)
 {
-    QTextEdit::setReadOnly(p_ro);
+    VEditBase::setReadOnly(p_ro);
     highlightCurrentLine();
 }
 
@@ -459,21 +721,25 @@ void VEdit::triggerHighlightSelectedWord()
     }
 }
 
+void VEdit::visibleBlockRange(int &p_firstBlock, int &p_lastBlock) const
+{
+    QRect rect = viewport()->rect();
+    p_firstBlock = cursorForPosition(rect.topLeft()).blockNumber();
+    p_lastBlock = cursorForPosition(rect.bottomRight()).blockNumber();
+}
+
 void VEdit::highlightTextAll(const QString &p_text, uint p_options,
                              SelectionId p_id, QTextCharFormat p_format)
 {
+    HighlightText &hl = m_highlightTexts[(int)p_id];
+    hl.m_text = p_text;
+    hl.m_options = p_options;
+    hl.m_format = p_format;
+    hl.m_firstBlock = hl.m_lastBlock = -1;
+
     QList<QTextEdit::ExtraSelection> &selects = m_extraSelections[(int)p_id];
     if (!p_text.isEmpty()) {
-        selects.clear();
-
-        QList<QTextCursor> occurs = findTextAll(p_text, p_options);
-        for (int i = 0; i < occurs.size(); ++i) {
-            QTextEdit::ExtraSelection select;
-            select.format = p_format;
-            select.cursor = occurs[i];
-            selects.append(select);
-        }
-        qDebug() << "highlight" << selects.size() << "occurences of" << p_text;
+        highlightVisibleText(p_id);
     } else {
         if (selects.isEmpty()) {
             return;
@@ -483,6 +749,221 @@ void VEdit::highlightTextAll(const QString &p_text, uint p_options,
     highlightExtraSelections();
 }
 
+void VEdit::highlightVisibleText(SelectionId p_id)
+{
+    HighlightText &hl = m_highlightTexts[(int)p_id];
+    QList<QTextEdit::ExtraSelection> &selects = m_extraSelections[(int)p_id];
+    selects.clear();
+
+    // Extend the visible range by one page above and below to avoid
+    // re-highlighting on every small scroll.
+    QTextDocument *doc = document();
+    int firstBlock, lastBlock;
+    visibleBlockRange(firstBlock, lastBlock);
+    int nrBlocks = lastBlock - firstBlock + 1;
+    firstBlock = qMax(0, firstBlock - nrBlocks);
+    lastBlock = qMin(doc->blockCount() - 1, lastBlock + nrBlocks);
+    hl.m_firstBlock = firstBlock;
+    hl.m_lastBlock = lastBlock;
+
+    QTextBlock block = doc->findBlockByNumber(firstBlock);
+    int offset = block.position();
+    QString content;
+    for (int i = firstBlock; i <= lastBlock && block.isValid(); ++i) {
+        if (i > firstBlock) {
+            content.append('\n');
+        }
+        content.append(block.text());
+        block = block.next();
+    }
+
+    QVector<QPair<int, int> > ranges;
+    findAllInText(content, hl.m_text, hl.m_options,
+                  regExpForOptions(hl.m_text, hl.m_options), ranges, QString(), NULL);
+    for (int i = 0; i < ranges.size(); ++i) {
+        QTextEdit::ExtraSelection select;
+        select.format = hl.m_format;
+        select.cursor = QTextCursor(doc);
+        select.cursor.setPosition(offset + ranges[i].first);
+        select.cursor.setPosition(offset + ranges[i].first + ranges[i].second,
+                                  QTextCursor::KeepAnchor);
+        selects.append(select);
+    }
+    qDebug() << "highlight" << selects.size() << "occurences of" << hl.m_text
+             << "in blocks" << firstBlock << lastBlock;
+}
+
+void VEdit::updateVisibleHighlights()
+{
+    int firstBlock, lastBlock;
+    visibleBlockRange(firstBlock, lastBlock);
+    bool updated = false;
+    for (int i = 0; i < m_highlightTexts.size(); ++i) {
+        const HighlightText &hl = m_highlightTexts[i];
+        if (hl.m_text.isEmpty()) {
+            continue;
+        }
+        if (hl.m_firstBlock == -1
+            || firstBlock < hl.m_firstBlock
+            || lastBlock > hl.m_lastBlock) {
+            highlightVisibleText((SelectionId)i);
+            updated = true;
+        }
+    }
+    if (updated) {
+        highlightExtraSelections();
+    }
+}
+
+void VEdit::invalidateHighlightRanges()
+{
+    bool highlighted = false;
+    for (int i = 0; i < m_highlightTexts.size(); ++i) {
+        HighlightText &hl = m_highlightTexts[i];
+        hl.m_firstBlock = hl.m_lastBlock = -1;
+        if (!hl.m_text.isEmpty()) {
+            highlighted = true;
+        }
+    }
+    if (highlighted) {
+        // Re-highlight once the typing pauses.
+        m_highlightUpdateTimer->start();
+    }
+}
+
+void VEdit::truncateUndoSteps(int p_steps)
+{
+    if (p_steps < 0) {
+        p_steps = 0;
+    }
+    for (int i = p_steps; i < m_undoStepSizes.size(); ++i) {
+        m_undoMemory -= m_undoStepSizes[i];
+    }
+    m_undoStepSizes.resize(qMin(p_steps, m_undoStepSizes.size()));
+}
+
+void VEdit::handleUndoCommandAdded()
+{
+    int steps = document()->availableUndoSteps();
+    if (steps == m_lastUndoSteps && steps == m_undoStepSizes.size()) {
+        // An edit block joined the last command.
+        return;
+    }
+    // A new command drops the redo steps.
+    truncateUndoSteps(steps - 1);
+    m_undoStepSizes.resize(qMax(steps - 1, 0));
+    m_undoStepSizes.append(c_undoCommandSize);
+    m_undoMemory += c_undoCommandSize;
+    m_lastUndoSteps = steps;
+}
+
+void VEdit::handleUndoContentsChange(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    Q_UNUSED(p_position);
+    // undoCommandAdded() is emitted before contentsChange(). QTextDocument
+    // merges consecutive typing into the last command without notification.
+    // Undo and redo change the available steps.
+    // The removed text stays in the document buffer and the added text is
+    // appended to it as long as the history refers to them, so both count.
+    QTextDocument *doc = document();
+    int steps = doc->availableUndoSteps();
+    if (steps > 0
+        && steps == m_lastUndoSteps
+        && steps == m_undoStepSizes.size()
+        && doc->availableRedoSteps() == 0) {
+        qint64 size = (qint64)(p_charsAdded + p_charsRemoved) * sizeof(QChar);
+        m_undoStepSizes.last() += size;
+        m_undoMemory += size;
+        checkUndoBudget();
+    } else {
+        // The stacks may be cleared without notification.
+        truncateUndoSteps(steps + doc->availableRedoSteps());
+    }
+    m_lastUndoSteps = steps;
+}
+
+bool VEdit::exceedsUndoBudget() const
+{
+    qint64 budget = (qint64)vconfig.getUndoMemoryBudget() * 1024 * 1024;
+    if (budget <= 0 || m_undoMemory <= budget || m_undoStepSizes.isEmpty()) {
+        return false;
+    }
+    // Keep a large step, such as a paste, undoable until the next one.
+    return m_undoStepSizes.last() <= budget;
+}
+
+void VEdit::setUndoCompactionSuspended(bool p_suspended)
+{
+    m_undoCompactSuspended = p_suspended;
+    if (!p_suspended) {
+        checkUndoBudget();
+    }
+}
+
+void VEdit::checkUndoBudget()
+{
+    if (m_undoCompactPending || m_undoCompactSuspended || !exceedsUndoBudget()) {
+        return;
+    }
+    // Do not touch the stacks within the signals of QTextDocument.
+    m_undoCompactPending = true;
+    QMetaObject::invokeMethod(this, "compactUndoHistory", Qt::QueuedConnection);
+}
+
+void VEdit::compactUndoHistory()
+{
+    m_undoCompactPending = false;
+    if (m_undoCompactSuspended || !exceedsUndoBudget()) {
+        return;
+    }
+    // QTextDocument could not drop part of its history, so clear all of it,
+    // which also frees the text only referred by the history.
+    qDebug() << "undo history exceeds the budget" << m_undoMemory
+             << "steps" << m_undoStepSizes.size();
+    document()->clearUndoRedoStacks();
+    m_undoStepSizes.clear();
+    m_undoMemory = 0;
+    m_lastUndoSteps = 0;
+}
+
+void VEdit::resizeEvent(QResizeEvent *p_event)
+{
+    VEditBase::resizeEvent(p_event);
+    updateVisibleHighlights();
+}
+
+void VEdit::countTextAll(const QString &p_text, uint p_options)
+{
+    int revision = document()->revision();
+    if (p_text == m_countText && p_options == m_countOptions
+        && revision == m_countRevision) {
+        if (!m_countWatcher->isRunning()) {
+            handleCountFinished();
+        }
+        return;
+    }
+    m_countText = p_text;
+    m_countOptions = p_options;
+    m_countRevision = revision;
+    // The watcher will stop watching the previous count.
+    m_countWatcher->setFuture(QtConcurrent::run(&VEdit::countTextInContent,
+                                                searchSnapshot(), p_text, p_options,
+                                                regExpForOptions(p_text, p_options)));
+}
+
+int VEdit::countTextInContent(const QString &p_content, const QString &p_text,
+                              uint p_options, const QRegularExpression &p_exp)
+{
+    QVector<QPair<int, int> > ranges;
+    findAllInText(p_content, p_text, p_options, p_exp, ranges, QString(), NULL);
+    return ranges.size();
+}
+
+void VEdit::handleCountFinished()
+{
+    emit textCountUpdated(m_countText, m_countOptions, m_countWatcher->result());
+}
+
 void VEdit::highlightSearchedWord(const QString &p_text, uint p_options)
 {
     QTextCharFormat format;
@@ -496,6 +977,7 @@ void VEdit::highlightSearchedWord(const QString &p_text, uint p_options)
 
 void VEdit::clearSearchedWordHighlight()
 {
+    clearPeekCandidates();
     QList<QTextEdit::ExtraSelection> &selects = m_extraSelections[(int)SelectionId::SearchedKeyword];
     selects.clear();
     highlightExtraSelections();
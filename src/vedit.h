@@ -1,12 +1,23 @@
 #ifndef VEDIT_H
 #define VEDIT_H
 
+#ifdef VNOTE_PLAIN_TEXT_EDITOR
+#include <QPlainTextEdit>
+// Lay out the document lazily block by block. Rich text of HTML notes, such
+// as tables, lists and images, could not be laid out.
+typedef QPlainTextEdit VEditBase;
+#else
 #include <QTextEdit>
+typedef QTextEdit VEditBase;
+#endif
 #include <QString>
 #include <QPointer>
 #include <QVector>
 #include <QList>
 #include <QColor>
+#include <QPair>
+#include <QTextCharFormat>
+#include <QRegularExpression>
 #include "vconstants.h"
 #include "vtoc.h"
 #include "vfile.h"
@@ -14,6 +25,7 @@
 class VEditOperations;
 class QLabel;
 class QTimer;
+template <typename T> class QFutureWatcher;
 
 enum class SelectionId {
     CurrentLine = 0,
@@ -22,7 +34,7 @@ enum class SelectionId {
     MaxSelection
 };
 
-class VEdit : public QTextEdit
+class VEdit : public VEditBase
 {
     Q_OBJECT
 public:
@@ -44,15 +56,40 @@ public:
     bool findText(const QString &p_text, uint p_options, bool p_forward);
     void replaceText(const QString &p_text, uint p_options,
                      const QString &p_replaceText, bool p_findNext);
-    void replaceTextAll(const QString &p_text, uint p_options,
-                        const QString &p_replaceText);
+    // Replace all the occurences of @p_text with @p_replaceText within one
+    // edit block. In regular expression mode, \1 to \99 in @p_replaceText
+    // refer to the captured texts.
+    // Returns the number of replaced occurences.
+    int replaceTextAll(const QString &p_text, uint p_options,
+                       const QString &p_replaceText);
     void setReadOnly(bool p_ro);
     void clearSearchedWordHighlight();
+    // Estimated memory in bytes held by the undo and redo history.
+    inline qint64 getUndoMemory() const;
+    // Number of undo and redo steps.
+    inline int getUndoSteps() const;
+
+signals:
+    // Emitted when the total number of occurences of @p_text is counted.
+    void textCountUpdated(const QString &p_text, uint p_options, int p_count);
 
 private slots:
     void labelTimerTimeout();
     void triggerHighlightSelectedWord();
     void highlightSelectedWord();
+    // Re-highlight the words if the viewport goes beyond the highlighted range.
+    void updateVisibleHighlights();
+    // Text changes shift the blocks so the highlighted ranges are not valid.
+    // Re-highlight later.
+    void invalidateHighlightRanges();
+    void handleCountFinished();
+    // Free the search snapshot once the document changes.
+    void releaseSearchSnapshot();
+    void handleUndoCommandAdded();
+    void handleUndoContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+    // Clear the undo history if it exceeds the budget. QTextDocument could
+    // not drop only the oldest steps.
+    void compactUndoHistory();
 
 protected slots:
     virtual void highlightCurrentLine();
@@ -63,27 +100,137 @@ protected:
     QColor m_cursorLineColor;
 
     virtual void updateFontAndPalette();
+    void resizeEvent(QResizeEvent *p_event) Q_DECL_OVERRIDE;
+    // Do not clear the undo history for the budget while suspended, such as
+    // within an edit block spanning several events. The budget is checked
+    // again when resumed.
+    void setUndoCompactionSuspended(bool p_suspended);
 
 private:
+    // Text highlighted within the viewport.
+    struct HighlightText
+    {
+        HighlightText() : m_options(0), m_firstBlock(-1), m_lastBlock(-1)
+        {
+        }
+
+        QString m_text;
+        uint m_options;
+        QTextCharFormat m_format;
+        // Range of block numbers highlighted.
+        int m_firstBlock;
+        int m_lastBlock;
+    };
+
     QLabel *m_wrapLabel;
     QTimer *m_labelTimer;
     // highlightExtraSelections() will highlight these selections.
     // Selections are indexed by SelectionId.
     QVector<QList<QTextEdit::ExtraSelection> > m_extraSelections;
     QTimer *m_selectedWordTimer;
+    // Coalesce re-highlighting after text changes.
+    QTimer *m_highlightUpdateTimer;
     QColor m_selectedWordColor;
     QColor m_searchedWordColor;
+    // Indexed by SelectionId.
+    QVector<HighlightText> m_highlightTexts;
+    // Count the occurences of the searched text in another thread.
+    QFutureWatcher<int> *m_countWatcher;
+    QString m_countText;
+    uint m_countOptions;
+    int m_countRevision;
+    QRegularExpression m_regExp;
+
+    // State of incremental search.
+    int m_peekStartPos;
+    int m_peekLastPos;
+    QString m_peekText;
+    uint m_peekOptions;
+    int m_peekRevision;
+    // Snapshot of the document the candidates are computed from, also used
+    // by find and count at revision m_peekContentRevision. Freed once the
+    // document changes or the search is done.
+    QString m_peekContent;
+    int m_peekContentRevision;
+    // Sorted positions matching m_peekText regardless of whole word.
+    QVector<int> m_peekCandidates;
+
+    // Estimated bytes of each undo step followed by the redo steps.
+    QVector<qint64> m_undoStepSizes;
+    qint64 m_undoMemory;
+    // Available undo steps at the last change.
+    int m_lastUndoSteps;
+    bool m_undoCompactPending;
+    bool m_undoCompactSuspended;
 
     void showWrapLabel();
     void highlightExtraSelections();
-    // Find all the occurences of @p_text.
-    QList<QTextCursor> findTextAll(const QString &p_text, uint p_options);
+    // Get the block numbers of the first and last visible blocks.
+    void visibleBlockRange(int &p_firstBlock, int &p_lastBlock) const;
+    // Only the occurences within the viewport and one page around are
+    // highlighted.
     void highlightTextAll(const QString &p_text, uint p_options,
                           SelectionId p_id, QTextCharFormat p_format);
+    void highlightVisibleText(SelectionId p_id);
+    // Count all the occurences of @p_text asynchronously.
+    void countTextAll(const QString &p_text, uint p_options);
+    static int countTextInContent(const QString &p_content, const QString &p_text,
+                                  uint p_options, const QRegularExpression &p_exp);
     void highlightSearchedWord(const QString &p_text, uint p_options);
+    // Find the first match of @p_text in @p_content starting at or after
+    // @p_from, or the last one starting at or before @p_from if not
+    // @p_forward. -1 for @p_from means the end of @p_content.
+    // Returns the position of the match and sets @p_length.
+    int findInText(const QString &p_content, const QString &p_text, uint p_options,
+                   int p_from, bool p_forward, int &p_length);
+    // Get the regular expression for @p_text compiled and optimized, which is
+    // cached until the text or options change.
+    const QRegularExpression &cachedRegExp(const QString &p_text, uint p_options);
+    // Get the cached regular expression if @p_options asks for it.
+    QRegularExpression regExpForOptions(const QString &p_text, uint p_options);
+    // Compute the matches of @p_text for incremental search. Narrow the
+    // previous matches if @p_text extends the previous text.
+    void updatePeekCandidates(const QString &p_text, uint p_options);
+    void clearPeekCandidates();
+    // Plain text of the document, taken again if the document has changed.
+    const QString &searchSnapshot();
+    // Find the first valid match of @p_exp within [p_from, p_end) of
+    // @p_content.
+    static int findRegExp(const QString &p_content, const QRegularExpression &p_exp,
+                          bool p_wholeWord, int p_from, int p_end, int &p_length);
     bool wordInSearchedSelection(const QString &p_text);
+    // Find all the occurences of @p_text in @p_content in one scan.
+    // @p_replaceText will be expanded with the captured texts of each match
+    // into @p_replaceTexts in regular expression mode, in which @p_exp is
+    // the compiled @p_text.
+    static void findAllInText(const QString &p_content, const QString &p_text,
+                              uint p_options, const QRegularExpression &p_exp,
+                              QVector<QPair<int, int> > &p_ranges,
+                              const QString &p_replaceText,
+                              QVector<QString> *p_replaceTexts);
+    // Whether [p_start, p_end) of @p_text is a whole word.
+    static bool isWholeWord(const QString &p_text, int p_start, int p_end);
+    // Replace \N in @p_replaceText with the Nth captured text of @p_match.
+    static QString expandCapturedTexts(const QString &p_replaceText,
+                                       const QRegularExpressionMatch &p_match);
+    // Drop the accounting of steps from @p_steps on.
+    void truncateUndoSteps(int p_steps);
+    void checkUndoBudget();
+    // Whether the history should be cleared for the budget. A last step
+    // exceeding the budget alone is kept.
+    bool exceedsUndoBudget() const;
 };
 
+inline qint64 VEdit::getUndoMemory() const
+{
+    return m_undoMemory;
+}
+
+inline int VEdit::getUndoSteps() const
+{
+    return m_undoStepSizes.size();
+}
+
 
 
 #endif // VEDIT_H
@@ -5,6 +5,7 @@
 #include "vnote.h"
 #include "vconfigmanager.h"
 #include "vfile.h"
+#include "vmainwindow.h"
 #include "dialog/vfindreplacedialog.h"
 #include "utils/vutils.h"
 
@@ -94,8 +95,7 @@ void VEditArea::removeSplitWindow(VEditWindow *win)
     win->deleteLater();
 }
 
-// A given file can be opened in multiple split windows. A given file could be
-// opened at most in one tab inside a window.
+// A given file is opened in at most one tab among all the split windows.
 void VEditArea::openFile(VFile *p_file, OpenFileMode p_mode)
 {
     if (!p_file) {
@@ -103,7 +103,8 @@ void VEditArea::openFile(VFile *p_file, OpenFileMode p_mode)
     }
     qDebug() << "VEditArea open" << p_file->getName() << (int)p_mode;
 
-    // Find if it has been opened already
+    // Find if it has been opened already, so its document and highlighter are
+    // never duplicated.
     int winIdx, tabIdx;
     bool setFocus = false;
     auto tabs = findTabsByFile(p_file);
@@ -438,6 +439,19 @@ VEditTab *VEditArea::currentEditTab()
     return win->currentEditTab();
 }
 
+QVector<VEditTab *> VEditArea::getAllTabs() const
+{
+    QVector<VEditTab *> tabs;
+    int nrWin = splitter->count();
+    for (int i = 0; i < nrWin; ++i) {
+        VEditWindow *win = getWindow(i);
+        for (int j = 0; j < win->count(); ++j) {
+            tabs.append(win->getTab(j));
+        }
+    }
+    return tabs;
+}
+
 int VEditArea::windowIndex(const VEditWindow *p_window) const
 {
     int nrWin = splitter->count();
@@ -509,7 +523,9 @@ void VEditArea::handleReplaceAll(const QString &p_text, uint p_options,
     qDebug() << "replace all" << p_text << p_options << "with" << p_replaceText;
     VEditTab *tab = currentEditTab();
     if (tab) {
-        tab->replaceTextAll(p_text, p_options, p_replaceText);
+        int nrReplaces = tab->replaceTextAll(p_text, p_options, p_replaceText);
+        vnote->getMainWindow()->showStatusMessage(tr("Replaced %1 occurence(s)")
+                                                  .arg(nrReplaces));
     }
 }
 
@@ -32,6 +32,8 @@ public:
     bool closeFile(const VNotebook *p_notebook, bool p_forced);
     // Returns current edit tab.
     VEditTab *currentEditTab();
+    // Returns the tabs of all the windows.
+    QVector<VEditTab *> getAllTabs() const;
     // Returns the count of VEditWindow.
     inline int windowCount() const;
     // Returns the index of @p_window.
@@ -0,0 +1,318 @@
+#include "veditjournal.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QTimer>
+#include <QCryptographicHash>
+#include <QDebug>
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "vconfigmanager.h"
+#include "vmdedit.h"
+#include "vfilewriter.h"
+
+extern VConfigManager vconfig;
+
+// "VJNL"
+const quint32 VEditJournal::c_magic = 0x564a4e4cU;
+const quint32 VEditJournal::c_version = 3;
+
+// Interval in ms to flush the changes to disk.
+static const int c_flushInterval = 1000;
+
+enum JournalRecord { ChangeRecord = 1 };
+
+VEditJournal::VEditJournal(QObject *p_parent)
+    : QObject(p_parent), m_active(false), m_recording(false), m_hasChanges(false)
+{
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(c_flushInterval);
+    connect(m_flushTimer, &QTimer::timeout,
+            this, &VEditJournal::flush);
+}
+
+VEditJournal::~VEditJournal()
+{
+    flush();
+}
+
+void VEditJournal::start(const QString &p_notePath, const QByteArray &p_baseHash,
+                         const QVector<QPair<int, QString> > &p_previewBlocks)
+{
+    if (m_active && m_notePath == p_notePath) {
+        // Keep current journal as the previous one until the save is done.
+        flush();
+        m_flushTimer->stop();
+        if (m_file.isOpen()) {
+            m_file.close();
+            QString prevPath = previousJournalPath(m_notePath);
+            QFile::remove(prevPath);
+            QFile::rename(journalPath(m_notePath), prevPath);
+        }
+    } else {
+        discard();
+    }
+
+    m_notePath = p_notePath;
+    m_active = true;
+    m_recording = true;
+    m_hasChanges = false;
+    m_buffer.clear();
+    QDataStream out(&m_buffer, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << c_magic << c_version << p_notePath << p_baseHash
+        << (qint32)p_previewBlocks.size();
+    for (int i = 0; i < p_previewBlocks.size(); ++i) {
+        out << (qint32)p_previewBlocks[i].first << p_previewBlocks[i].second;
+    }
+}
+
+void VEditJournal::dropPrevious()
+{
+    if (!m_notePath.isEmpty()) {
+        QFile::remove(previousJournalPath(m_notePath));
+    }
+}
+
+void VEditJournal::discard()
+{
+    m_flushTimer->stop();
+    m_file.close();
+    m_buffer.clear();
+    m_hasChanges = false;
+    m_recording = false;
+    if (m_active) {
+        QFile::remove(journalPath(m_notePath));
+        QFile::remove(previousJournalPath(m_notePath));
+        m_active = false;
+    }
+}
+
+void VEditJournal::stop()
+{
+    flush();
+    m_flushTimer->stop();
+    m_recording = false;
+}
+
+QByteArray VEditJournal::contentHash(const QByteArray &p_utf8Content)
+{
+    return QCryptographicHash::hash(p_utf8Content, QCryptographicHash::Sha1);
+}
+
+void VEditJournal::recordChange(int p_position, int p_charsRemoved,
+                                const QString &p_addedText)
+{
+    if (!m_active || !m_recording) {
+        return;
+    }
+    QDataStream out(&m_buffer, QIODevice::WriteOnly | QIODevice::Append);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << (quint8)ChangeRecord << (qint32)p_position << (qint32)p_charsRemoved
+        << p_addedText;
+    m_hasChanges = true;
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void VEditJournal::flush()
+{
+    if (!m_active || !m_hasChanges || m_buffer.isEmpty()) {
+        return;
+    }
+    if (!m_file.isOpen()) {
+        QDir().mkpath(journalFolder());
+        m_file.setFileName(journalPath(m_notePath));
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "fail to open journal" << m_file.fileName();
+            return;
+        }
+    }
+    if (m_file.write(m_buffer) != m_buffer.size()) {
+        qWarning() << "fail to write journal" << m_file.fileName();
+    }
+    m_file.flush();
+    // Make it survive a system crash as well.
+#if defined(Q_OS_WIN)
+    _commit(m_file.handle());
+#else
+    fsync(m_file.handle());
+#endif
+    m_buffer.clear();
+}
+
+QString VEditJournal::journalFolder()
+{
+    return QDir(vconfig.getConfigFolder()).filePath("journals");
+}
+
+QString VEditJournal::journalPath(const QString &p_notePath)
+{
+    QByteArray hash = QCryptographicHash::hash(p_notePath.toUtf8(),
+                                               QCryptographicHash::Md5).toHex();
+    return QDir(journalFolder()).filePath(QString::fromLatin1(hash) + ".vjournal");
+}
+
+QString VEditJournal::previousJournalPath(const QString &p_notePath)
+{
+    return journalPath(p_notePath) + ".prev";
+}
+
+bool VEditJournal::readHeader(QDataStream &p_in, QString &p_notePath, QByteArray &p_baseHash,
+                              QVector<QPair<int, QString> > &p_previewBlocks)
+{
+    quint32 magic = 0, version = 0;
+    qint32 nrBlocks = 0;
+    p_in >> magic >> version;
+    if (magic != c_magic || version != c_version) {
+        return false;
+    }
+    p_in >> p_notePath >> p_baseHash >> nrBlocks;
+    for (int i = 0; i < nrBlocks && p_in.status() == QDataStream::Ok; ++i) {
+        qint32 blockNumber;
+        QString text;
+        p_in >> blockNumber >> text;
+        p_previewBlocks.append(QPair<int, QString>(blockNumber, text));
+    }
+    return p_in.status() == QDataStream::Ok;
+}
+
+QStringList VEditJournal::recoverableNotes()
+{
+    QStringList notes;
+    QDir dir(journalFolder());
+    QStringList filters;
+    filters << "*.vjournal" << "*.vjournal.prev";
+    QStringList journals = dir.entryList(filters, QDir::Files);
+    for (int i = 0; i < journals.size(); ++i) {
+        QString path = dir.filePath(journals[i]);
+        QFile file(path);
+        QString notePath;
+        QByteArray baseHash;
+        QVector<QPair<int, QString> > previewBlocks;
+        bool valid = false;
+        if (file.open(QIODevice::ReadOnly)) {
+            QDataStream in(&file);
+            in.setVersion(QDataStream::Qt_5_0);
+            valid = readHeader(in, notePath, baseHash, previewBlocks);
+            file.close();
+        }
+
+        QFileInfo noteInfo(notePath);
+        if (valid && noteInfo.exists()
+            && QFileInfo(path).lastModified() >= noteInfo.lastModified()) {
+            if (!notes.contains(notePath)) {
+                notes.append(notePath);
+            }
+        } else {
+            // The note has been saved or removed since then.
+            qDebug() << "remove stale journal" << path << notePath;
+            QFile::remove(path);
+        }
+    }
+    return notes;
+}
+
+bool VEditJournal::replay(const QString &p_journalPath, const QByteArray &p_utf8Content,
+                          QString &p_content)
+{
+    QFile file(p_journalPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    QString notePath;
+    QByteArray baseHash;
+    QVector<QPair<int, QString> > previewBlocks;
+    if (!readHeader(in, notePath, baseHash, previewBlocks)
+        || contentHash(p_utf8Content) != baseHash) {
+        return false;
+    }
+
+    // Rebuild the text of the document with the image preview blocks,
+    // on which the positions of the changes are based.
+    QString text = QString::fromUtf8(p_utf8Content);
+    if (!previewBlocks.isEmpty()) {
+        QStringList lines = text.split('\n');
+        for (int i = 0; i < previewBlocks.size(); ++i) {
+            int idx = qBound(0, previewBlocks[i].first, lines.size());
+            lines.insert(idx, previewBlocks[i].second);
+        }
+        text = lines.join('\n');
+    }
+
+    int nrChanges = 0;
+    while (!in.atEnd()) {
+        quint8 type;
+        qint32 pos, removed;
+        QString added;
+        in >> type >> pos >> removed >> added;
+        if (in.status() != QDataStream::Ok || type != ChangeRecord) {
+            // The last record may be partially written.
+            break;
+        }
+        pos = qBound(0, (int)pos, text.size());
+        removed = qBound(0, (int)removed, text.size() - pos);
+        text.replace(pos, removed, added);
+        ++nrChanges;
+    }
+
+    // Remove the image preview blocks.
+    QStringList lines = text.split('\n');
+    QStringList contentLines;
+    for (int i = 0; i < lines.size(); ++i) {
+        if (VMdEdit::isImagePreviewText(lines[i])) {
+            continue;
+        }
+        contentLines.append(lines[i].remove(QChar::ObjectReplacementCharacter));
+    }
+    p_content = contentLines.join('\n');
+    qDebug() << "replay" << nrChanges << "changes of" << p_journalPath;
+    return true;
+}
+
+bool VEditJournal::recover(const QString &p_notePath)
+{
+    // Read it as the editor does, so the bytes match those hashed.
+    QFile file(p_notePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "fail to read file" << p_notePath;
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    // If the last save was not done, replay the previous journal first.
+    QString content;
+    QString journal = journalPath(p_notePath);
+    QString prevJournal = previousJournalPath(p_notePath);
+    bool recovered = QFile::exists(journal) && replay(journal, data, content);
+    if (!recovered && QFile::exists(prevJournal) && replay(prevJournal, data, content)) {
+        recovered = true;
+        if (QFile::exists(journal)) {
+            replay(journal, content.toUtf8(), content);
+        }
+    }
+    if (!recovered) {
+        qWarning() << "fail to recover" << p_notePath << "from journals";
+        return false;
+    }
+    // Do not risk the note if it crashes again during writing.
+    if (!VFileWriter::writeFileAtomically(p_notePath, content.toUtf8())) {
+        return false;
+    }
+    removeJournals(p_notePath);
+    return true;
+}
+
+void VEditJournal::removeJournals(const QString &p_notePath)
+{
+    QFile::remove(journalPath(p_notePath));
+    QFile::remove(previousJournalPath(p_notePath));
+}
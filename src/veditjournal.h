@@ -0,0 +1,98 @@
+#ifndef VEDITJOURNAL_H
+#define VEDITJOURNAL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QPair>
+#include <QFile>
+
+class QTimer;
+class QDataStream;
+
+// Append-only journal of the changes of a note since it is saved, to recover
+// unsaved changes after a crash. Changes are buffered and flushed to disk
+// on a timer, so the cost is proportional to the changes, not to the size
+// of the note.
+// The journal of the previous save is kept until the save is done.
+class VEditJournal : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VEditJournal(QObject *p_parent = 0);
+    ~VEditJournal();
+
+    // Start a new journal of @p_notePath, whose saved content has the hash
+    // @p_baseHash computed by contentHash(). @p_previewBlocks are the block
+    // numbers and texts of image preview blocks in the document, which are
+    // not saved.
+    void start(const QString &p_notePath, const QByteArray &p_baseHash,
+               const QVector<QPair<int, QString> > &p_previewBlocks);
+
+    // The save the current journal starts from is done.
+    void dropPrevious();
+
+    // Stop recording and delete the journal.
+    void discard();
+
+    // Stop recording but keep the journal until discard() or start().
+    void stop();
+
+    // Record that @p_charsRemoved characters at @p_position are replaced by
+    // @p_addedText.
+    void recordChange(int p_position, int p_charsRemoved, const QString &p_addedText);
+
+    // Whether changes are being recorded.
+    inline bool isActive() const;
+
+    // Hash of the content in UTF-8 a journal is based on.
+    static QByteArray contentHash(const QByteArray &p_utf8Content);
+
+    // Notes having journals left behind, which are newer than the notes.
+    static QStringList recoverableNotes();
+
+    // Replay the journal of @p_notePath and write the recovered content to it.
+    static bool recover(const QString &p_notePath);
+
+    // Delete the journals of @p_notePath.
+    static void removeJournals(const QString &p_notePath);
+
+private slots:
+    void flush();
+
+private:
+    // Read the journal header. Returns false if it is not a valid journal.
+    static bool readHeader(QDataStream &p_in, QString &p_notePath, QByteArray &p_baseHash,
+                           QVector<QPair<int, QString> > &p_previewBlocks);
+    // Replay @p_journalPath on @p_utf8Content and put the result in
+    // @p_content. Returns false if @p_utf8Content is not the base of the
+    // journal.
+    static bool replay(const QString &p_journalPath, const QByteArray &p_utf8Content,
+                       QString &p_content);
+    static QString journalFolder();
+    static QString journalPath(const QString &p_notePath);
+    static QString previousJournalPath(const QString &p_notePath);
+
+    QString m_notePath;
+    bool m_active;
+    bool m_recording;
+    // Journal file opened on the first flush.
+    QFile m_file;
+    // Data not written to m_file yet.
+    QByteArray m_buffer;
+    // Whether any change is recorded. The journal is written only if true.
+    bool m_hasChanges;
+    QTimer *m_flushTimer;
+
+    static const quint32 c_magic;
+    static const quint32 c_version;
+};
+
+inline bool VEditJournal::isActive() const
+{
+    return m_active && m_recording;
+}
+
+#endif // VEDITJOURNAL_H
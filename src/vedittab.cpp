@@ -3,6 +3,7 @@
 #include <QWebEngineView>
 #include <QFileInfo>
 #include <QXmlStreamReader>
+#include <QtConcurrent/QtConcurrentRun>
 #include "vedittab.h"
 #include "vedit.h"
 #include "vdocument.h"
@@ -12,6 +13,8 @@
 #include "hgmarkdownhighlighter.h"
 #include "vconfigmanager.h"
 #include "vmarkdownconverter.h"
+#include "vrendercache.h"
+#include "vpreviewpool.h"
 #include "vnotebook.h"
 #include "vtoc.h"
 #include "vmdedit.h"
@@ -20,16 +23,34 @@
 #include "vconstants.h"
 
 extern VConfigManager vconfig;
+extern VNote *g_vnote;
+
+// Interval in ms of typing pause to update the live preview.
+static const int c_livePreviewInterval = 500;
+
+// Time in ms a tab stays in background before its preview view is released.
+static const int c_previewReleaseDelay = 30 * 1000;
 
 VEditTab::VEditTab(VFile *p_file, OpenFileMode p_mode, QWidget *p_parent)
     : QStackedWidget(p_parent), m_file(p_file), isEditMode(false), document(p_file, this),
       mdConverterType(vconfig.getMdConverterType()), m_fileModified(false),
-      m_editArea(NULL)
+      m_editArea(NULL), m_loadingProgress(100), m_renderOutlineIndex(0),
+      m_editSplitter(NULL), m_webZoomFactor(vconfig.getWebZoomFactor())
 {
     tableOfContent.filePath = p_file->retrivePath();
     curHeader.filePath = p_file->retrivePath();
     Q_ASSERT(!m_file->isOpened());
     m_file->open();
+    connect((VFile *)m_file, &VFile::saveFinished,
+            this, &VEditTab::handleSaveFinished);
+    m_renderWatcher = new QFutureWatcher<VMarkdownRender>(this);
+    connect(m_renderWatcher, &QFutureWatcher<VMarkdownRender>::finished,
+            this, &VEditTab::handleRenderFinished);
+    m_releasePreviewTimer = new QTimer(this);
+    m_releasePreviewTimer->setSingleShot(true);
+    m_releasePreviewTimer->setInterval(c_previewReleaseDelay);
+    connect(m_releasePreviewTimer, &QTimer::timeout,
+            this, &VEditTab::releasePreviewer);
     setupUI();
     if (p_mode == OpenFileMode::Edit) {
         showFileEditMode();
@@ -54,6 +75,8 @@ void VEditTab::init(VEditArea *p_editArea)
 
 void VEditTab::setupUI()
 {
+    // Created when preview is first shown.
+    webPreviewer = NULL;
     switch (m_file->getDocType()) {
     case DocType::Markdown:
         if (m_file->isModifiable()) {
@@ -62,12 +85,34 @@ void VEditTab::setupUI()
                     this, &VEditTab::updateTocFromHeaders);
             connect(dynamic_cast<VMdEdit *>(m_textEditor), &VMdEdit::statusChanged,
                     this, &VEditTab::noticeStatusChanged);
+            connect(dynamic_cast<VMdEdit *>(m_textEditor), &VMdEdit::loadingProgressChanged,
+                    this, &VEditTab::handleLoadingProgressChanged);
+            connect(dynamic_cast<VMdEdit *>(m_textEditor), &VMdEdit::statisticsChanged,
+                    this, &VEditTab::statisticsChanged);
             connect(m_textEditor, SIGNAL(curHeaderChanged(int, int)),
                     this, SLOT(updateCurHeader(int, int)));
             connect(m_textEditor, &VEdit::textChanged,
                     this, &VEditTab::handleTextChanged);
+            connect(m_textEditor, &VEdit::textCountUpdated,
+                    this, &VEditTab::handleTextCountUpdated);
             m_textEditor->reloadFile();
-            addWidget(m_textEditor);
+
+            // Live preview will be added beside the editor.
+            m_editSplitter = new QSplitter(Qt::Horizontal, this);
+            m_editSplitter->addWidget(m_textEditor);
+            m_editSplitter->setFocusProxy(m_textEditor);
+            addWidget(m_editSplitter);
+
+            m_livePreviewTimer = new QTimer(this);
+            m_livePreviewTimer->setSingleShot(true);
+            m_livePreviewTimer->setInterval(c_livePreviewInterval);
+            connect(m_livePreviewTimer, &QTimer::timeout,
+                    this, &VEditTab::renderLivePreview);
+            connect(m_textEditor, &VEdit::textChanged,
+                    this, &VEditTab::requestLivePreview);
+            m_liveWatcher = new QFutureWatcher<VMarkdownRender>(this);
+            connect(m_liveWatcher, &QFutureWatcher<VMarkdownRender>::finished,
+                    this, &VEditTab::handleLiveRenderFinished);
         } else {
             m_textEditor = NULL;
         }
@@ -78,9 +123,10 @@ void VEditTab::setupUI()
         m_textEditor = new VEdit(m_file, this);
         connect(m_textEditor, &VEdit::textChanged,
                 this, &VEditTab::handleTextChanged);
+        connect(m_textEditor, &VEdit::textCountUpdated,
+                this, &VEditTab::handleTextCountUpdated);
         m_textEditor->reloadFile();
         addWidget(m_textEditor);
-        webPreviewer = NULL;
         break;
     default:
         qWarning() << "unknown doc type" << int(m_file->getDocType());
@@ -91,12 +137,19 @@ void VEditTab::setupUI()
 void VEditTab::handleTextChanged()
 {
     Q_ASSERT(m_file->isModifiable());
-    if (m_fileModified) {
+    // Appending the content during loading does not modify the file.
+    if (m_fileModified || m_loadingProgress < 100) {
         return;
     }
     noticeStatusChanged();
 }
 
+void VEditTab::handleLoadingProgressChanged(int p_percent)
+{
+    m_loadingProgress = p_percent;
+    noticeStatusChanged();
+}
+
 void VEditTab::noticeStatusChanged()
 {
     m_fileModified = m_file->isModified();
@@ -107,21 +160,25 @@ void VEditTab::showFileReadMode()
 {
     qDebug() << "read" << m_file->getName();
     isEditMode = false;
+    updateLivePreview();
     int outlineIndex = curHeader.m_outlineIndex;
     switch (m_file->getDocType()) {
     case DocType::Html:
         m_textEditor->setReadOnly(true);
         break;
     case DocType::Markdown:
+        ensurePreviewer();
+        setCurrentWidget(webPreviewer);
+        clearSearchedWordHighlight();
         if (mdConverterType == MarkdownConverterType::Hoedown) {
+            // It may be rendered in background, so scroll after the rendering.
+            m_renderOutlineIndex = outlineIndex;
             previewByConverter();
         } else {
             document.updateText();
             updateTocFromHtml(document.getToc());
+            scrollPreviewToHeader(outlineIndex);
         }
-        setCurrentWidget(webPreviewer);
-        clearSearchedWordHighlight();
-        scrollPreviewToHeader(outlineIndex);
         break;
     default:
         qWarning() << "unknown doc type" << int(m_file->getDocType());
@@ -144,24 +201,107 @@ void VEditTab::scrollPreviewToHeader(int p_outlineIndex)
 
 void VEditTab::previewByConverter()
 {
-    VMarkdownConverter mdConverter;
     const QString &content = m_file->getContent();
-    QString html = mdConverter.generateHtml(content, vconfig.getMarkdownExtensions());
-    QRegularExpression tocExp("<p>\\[TOC\\]<\\/p>", QRegularExpression::CaseInsensitiveOption);
-    QString toc = mdConverter.generateToc(content, vconfig.getMarkdownExtensions());
-    processHoedownToc(toc);
-    html.replace(tocExp, toc);
-    document.setHtml(html);
-    updateTocFromHtml(toc);
+    hoedown_extensions options = vconfig.getMarkdownExtensions();
+    VMarkdownRender result;
+    if (VMarkdownConverter::findRender(content, options, result)) {
+        m_renderWatcher->cancel();
+        applyRender(result);
+        return;
+    }
+
+    // Keep the previous rendering until the new one arrives.
+    if (document.getHtml().isEmpty()) {
+        document.setHtml(QString("<p>%1</p>").arg(tr("Rendering...")));
+    }
+    // The watcher will stop watching the previous rendering.
+    const VNotebook *notebook = m_file->getNotebook();
+    m_renderWatcher->setFuture(QtConcurrent::run(&VRenderCache::render,
+                                                 notebook ? notebook->getPath() : QString(),
+                                                 content, options,
+                                                 vconfig.getRenderCacheSize()));
+}
+
+void VEditTab::handleRenderFinished()
+{
+    if (isEditMode || m_renderWatcher->isCanceled()) {
+        return;
+    }
+    applyRender(m_renderWatcher->result());
+}
+
+void VEditTab::applyRender(const VMarkdownRender &p_render)
+{
+    document.setHtml(p_render.m_html);
+    updateTocFromAnchors(p_render.m_headers);
+    scrollPreviewToHeader(m_renderOutlineIndex);
+}
+
+bool VEditTab::isLivePreviewShown() const
+{
+    return m_editSplitter && webPreviewer && webPreviewer->parentWidget() == m_editSplitter;
+}
+
+void VEditTab::updateLivePreview()
+{
+    if (!m_editSplitter) {
+        return;
+    }
+    bool show = isEditMode && vconfig.getLivePreview()
+                && mdConverterType == MarkdownConverterType::Hoedown;
+    if (show == isLivePreviewShown()) {
+        return;
+    }
+    if (show) {
+        ensurePreviewer();
+        m_editSplitter->addWidget(webPreviewer);
+        webPreviewer->show();
+        renderLivePreview();
+    } else {
+        m_livePreviewTimer->stop();
+        if (webPreviewer) {
+            // Move it back for read mode.
+            addWidget(webPreviewer);
+        }
+    }
+}
+
+void VEditTab::requestLivePreview()
+{
+    if (isLivePreviewShown()) {
+        m_livePreviewTimer->start();
+    }
+}
+
+void VEditTab::renderLivePreview()
+{
+    VMdEdit *mdEdit = dynamic_cast<VMdEdit *>(m_textEditor);
+    if (m_liveWatcher->isRunning() || mdEdit->isLoading()) {
+        // Try again later.
+        m_livePreviewTimer->start();
+        return;
+    }
+    m_liveWatcher->setFuture(QtConcurrent::run(&VEditTab::renderSnapshot,
+                                               mdEdit->getSnapshot(),
+                                               vconfig.getMarkdownExtensions()));
 }
 
-void VEditTab::processHoedownToc(QString &p_toc)
+VMarkdownRender VEditTab::renderSnapshot(const VTextSnapshot &p_snapshot,
+                                         hoedown_extensions p_options)
 {
-    // Hoedown will add '\n'.
-    p_toc.replace("\n", "");
-    // Hoedown will translate `_` in title to `<em>`.
-    p_toc.replace("<em>", "_");
-    p_toc.replace("</em>", "_");
+    QString text = p_snapshot.toPlainText(&VMdEdit::isImagePreviewText);
+    // Do not let the intermediate texts evict the renderings for read mode.
+    VMarkdownRender result = VMarkdownConverter::generateRender(text, p_options);
+    result.m_blocks = VMarkdownConverter::splitBlocks(result.m_html);
+    return result;
+}
+
+void VEditTab::handleLiveRenderFinished()
+{
+    if (isLivePreviewShown()) {
+        const VMarkdownRender &result = m_liveWatcher->result();
+        document.patchHtml(result.m_html, result.m_blocks);
+    }
 }
 
 void VEditTab::showFileEditMode()
@@ -174,10 +314,15 @@ void VEditTab::showFileEditMode()
     // beginEdit() may change curHeader.
     int outlineIndex = curHeader.m_outlineIndex;
     m_textEditor->beginEdit();
-    setCurrentWidget(m_textEditor);
+    if (m_editSplitter) {
+        setCurrentWidget(m_editSplitter);
+    } else {
+        setCurrentWidget(m_textEditor);
+    }
     if (m_file->getDocType() == DocType::Markdown) {
         dynamic_cast<VMdEdit *>(m_textEditor)->scrollToHeader(outlineIndex);
     }
+    updateLivePreview();
     m_textEditor->setFocus();
     noticeStatusChanged();
 }
@@ -191,8 +336,19 @@ bool VEditTab::closeFile(bool p_forced)
         showFileReadMode();
     } else {
         readFile();
+        if (!isEditMode && !m_file->waitForSaved()) {
+            // Keep the tab and its changes to let user save it again.
+            showFileEditMode();
+            m_textEditor->setModified(true);
+            noticeStatusChanged();
+        }
     }
-    return !isEditMode;
+    if (isEditMode) {
+        return false;
+    }
+    // The tab will be deleted. Leave the view to other tabs.
+    releasePreviewer();
+    return true;
 }
 
 void VEditTab::editFile()
@@ -257,37 +413,48 @@ bool VEditTab::saveFile()
                             QMessageBox::Ok, QMessageBox::Ok, this);
         return false;
     }
+    // The result will be reported by handleSaveFinished().
     m_textEditor->saveFile();
     ret = m_file->save();
-    if (!ret) {
-        VUtils::showMessage(QMessageBox::Warning, tr("Warning"), tr("Fail to save note."),
-                            tr("Fail to write to disk when saving a note. Please try it again."),
-                            QMessageBox::Ok, QMessageBox::Ok, this);
-        m_textEditor->setModified(true);
-    }
     noticeStatusChanged();
     return ret;
 }
 
-void VEditTab::setupMarkdownPreview()
+void VEditTab::handleSaveFinished(bool p_succeeded)
 {
-    const QString jsHolder("JS_PLACE_HOLDER");
-    const QString extraHolder("<!-- EXTRA_PLACE_HOLDER -->");
-
-    webPreviewer = new QWebEngineView(this);
-    VPreviewPage *page = new VPreviewPage(this);
-    webPreviewer->setPage(page);
-    webPreviewer->setZoomFactor(vconfig.getWebZoomFactor());
+    if (p_succeeded) {
+        return;
+    }
+    VUtils::showMessage(QMessageBox::Warning, tr("Warning"), tr("Fail to save note."),
+                        tr("Fail to write to disk when saving a note. Please try it again."),
+                        QMessageBox::Ok, QMessageBox::Ok, this);
+    if (isEditMode) {
+        m_textEditor->setModified(true);
+        noticeStatusChanged();
+    }
+}
 
-    QWebChannel *channel = new QWebChannel(this);
-    channel->registerObject(QStringLiteral("content"), &document);
+void VEditTab::setupMarkdownPreview()
+{
     connect(&document, &VDocument::tocChanged,
             this, &VEditTab::updateTocFromHtml);
     connect(&document, SIGNAL(headerChanged(const QString&)),
             this, SLOT(updateCurHeader(const QString &)));
     connect(&document, &VDocument::keyPressed,
             this, &VEditTab::handleWebKeyPressed);
-    page->setWebChannel(channel);
+}
+
+void VEditTab::ensurePreviewer()
+{
+    if (webPreviewer) {
+        return;
+    }
+    const QString jsHolder("JS_PLACE_HOLDER");
+    const QString extraHolder("<!-- EXTRA_PLACE_HOLDER -->");
+
+    webPreviewer = g_vnote->getPreviewPool()->acquire();
+    webPreviewer->setZoomFactor(m_webZoomFactor);
+    webPreviewer->page()->webChannel()->registerObject(QStringLiteral("content"), &document);
 
     QString jsFile, extraFile;
     switch (mdConverterType) {
@@ -333,10 +500,52 @@ void VEditTab::setupMarkdownPreview()
     if (!extraFile.isEmpty()) {
         htmlTemplate.replace(extraHolder, extraFile);
     }
+    // The page will fetch the content from document once loaded.
     webPreviewer->setHtml(htmlTemplate, QUrl::fromLocalFile(m_file->retriveBasePath() + QDir::separator()));
     addWidget(webPreviewer);
 }
 
+void VEditTab::releasePreviewer()
+{
+    if (!webPreviewer) {
+        return;
+    }
+    qDebug() << "release preview of" << m_file->getName();
+    if (m_editSplitter) {
+        m_livePreviewTimer->stop();
+    }
+    m_webZoomFactor = webPreviewer->zoomFactor();
+    webPreviewer->page()->webChannel()->deregisterObject(&document);
+    g_vnote->getPreviewPool()->release(webPreviewer);
+    webPreviewer = NULL;
+}
+
+void VEditTab::showEvent(QShowEvent *p_event)
+{
+    QStackedWidget::showEvent(p_event);
+    m_releasePreviewTimer->stop();
+    if (webPreviewer || m_file->getDocType() != DocType::Markdown) {
+        return;
+    }
+    // Take a view again for the released preview.
+    if (!isEditMode) {
+        ensurePreviewer();
+        setCurrentWidget(webPreviewer);
+        scrollPreviewToHeader(curHeader.m_outlineIndex);
+    } else {
+        updateLivePreview();
+    }
+}
+
+void VEditTab::hideEvent(QHideEvent *p_event)
+{
+    QStackedWidget::hideEvent(p_event);
+    // Keep the view if the whole window is hidden, such as minimized.
+    if (webPreviewer && !p_event->spontaneous()) {
+        m_releasePreviewTimer->start();
+    }
+}
+
 void VEditTab::focusTab()
 {
     currentWidget()->setFocus();
@@ -359,10 +568,7 @@ void VEditTab::updateTocFromHtml(const QString &tocHtml)
     if (isEditMode) {
         return;
     }
-    tableOfContent.type = VHeaderType::Anchor;
-    QVector<VHeader> &headers = tableOfContent.headers;
-    headers.clear();
-
+    QVector<VHeader> headers;
     if (!tocHtml.isEmpty()) {
         QXmlStreamReader xml(tocHtml);
         if (xml.readNextStartElement()) {
@@ -377,7 +583,16 @@ void VEditTab::updateTocFromHtml(const QString &tocHtml)
             return;
         }
     }
+    updateTocFromAnchors(headers);
+}
 
+void VEditTab::updateTocFromAnchors(const QVector<VHeader> &p_headers)
+{
+    if (isEditMode) {
+        return;
+    }
+    tableOfContent.type = VHeaderType::Anchor;
+    tableOfContent.headers = p_headers;
     tableOfContent.filePath = m_file->retrivePath();
     tableOfContent.valid = true;
 
@@ -532,6 +747,30 @@ void VEditTab::insertImage()
     m_textEditor->insertImage();
 }
 
+void VEditTab::toggleFold()
+{
+    VMdEdit *mdEdit = dynamic_cast<VMdEdit *>(m_textEditor);
+    if (isEditMode && mdEdit) {
+        mdEdit->toggleFold();
+    }
+}
+
+void VEditTab::foldOtherSections()
+{
+    VMdEdit *mdEdit = dynamic_cast<VMdEdit *>(m_textEditor);
+    if (isEditMode && mdEdit) {
+        mdEdit->foldOtherSections();
+    }
+}
+
+void VEditTab::unfoldAll()
+{
+    VMdEdit *mdEdit = dynamic_cast<VMdEdit *>(m_textEditor);
+    if (isEditMode && mdEdit) {
+        mdEdit->unfoldAll();
+    }
+}
+
 void VEditTab::findText(const QString &p_text, uint p_options, bool p_peek,
                         bool p_forward)
 {
@@ -554,11 +793,20 @@ void VEditTab::replaceText(const QString &p_text, uint p_options,
     }
 }
 
-void VEditTab::replaceTextAll(const QString &p_text, uint p_options,
-                              const QString &p_replaceText)
+int VEditTab::replaceTextAll(const QString &p_text, uint p_options,
+                             const QString &p_replaceText)
 {
     if (isEditMode) {
-        m_textEditor->replaceTextAll(p_text, p_options, p_replaceText);
+        return m_textEditor->replaceTextAll(p_text, p_options, p_replaceText);
+    }
+    return 0;
+}
+
+void VEditTab::handleTextCountUpdated(const QString &p_text, uint p_options,
+                                      int p_count)
+{
+    if (m_editArea) {
+        m_editArea->getFindReplaceDialog()->setMatchCount(p_text, p_options, p_count);
     }
 }
 
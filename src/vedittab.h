@@ -4,6 +4,7 @@
 #include <QStackedWidget>
 #include <QString>
 #include <QPointer>
+#include <QFutureWatcher>
 #include "vconstants.h"
 #include "vdocument.h"
 #include "vmarkdownconverter.h"
@@ -11,11 +12,14 @@
 #include "vedit.h"
 #include "vtoc.h"
 #include "vfile.h"
+#include "vtextsnapshot.h"
 
 class QWebEngineView;
 class VNote;
 class QXmlStreamReader;
 class VEditArea;
+class QSplitter;
+class QTimer;
 
 class VEditTab : public QStackedWidget
 {
@@ -34,31 +38,46 @@ public:
 
     inline bool getIsEditMode() const;
     inline bool isModified() const;
+    // Progress in percent of loading the file into the editor.
+    inline int getLoadingProgress() const;
+    inline const VEdit *getEditor() const;
     void focusTab();
     void requestUpdateOutline();
     void requestUpdateCurHeader();
     void scrollToAnchor(const VAnchor& anchor);
     inline VFile *getFile();
     void insertImage();
+    // Folding in edit mode of Markdown notes.
+    void toggleFold();
+    void foldOtherSections();
+    void unfoldAll();
     // Search @p_text in current note.
     void findText(const QString &p_text, uint p_options, bool p_peek,
                   bool p_forward = true);
     // Replace @p_text with @p_replaceText in current note.
     void replaceText(const QString &p_text, uint p_options,
                      const QString &p_replaceText, bool p_findNext);
-    void replaceTextAll(const QString &p_text, uint p_options,
-                        const QString &p_replaceText);
+    // Returns the number of replaced occurences.
+    int replaceTextAll(const QString &p_text, uint p_options,
+                       const QString &p_replaceText);
     QString getSelectedText() const;
     void clearSearchedWordHighlight();
+    // Show or hide the live preview beside the editor according to the
+    // configuration and current mode.
+    void updateLivePreview();
 
 protected:
     void wheelEvent(QWheelEvent *p_event) Q_DECL_OVERRIDE;
+    void showEvent(QShowEvent *p_event) Q_DECL_OVERRIDE;
+    void hideEvent(QHideEvent *p_event) Q_DECL_OVERRIDE;
 
 signals:
     void getFocused();
     void outlineChanged(const VToc &toc);
     void curHeaderChanged(const VAnchor &anchor);
     void statusChanged();
+    // Counts of the note or the selection change.
+    void statisticsChanged();
 
 private slots:
     void handleFocusChanged(QWidget *old, QWidget *now);
@@ -67,16 +86,36 @@ private slots:
     void updateCurHeader(int p_lineNumber, int p_outlineIndex);
     void updateTocFromHeaders(const QVector<VHeader> &headers);
     void handleTextChanged();
+    void handleTextCountUpdated(const QString &p_text, uint p_options, int p_count);
+    void handleLoadingProgressChanged(int p_percent);
+    void handleSaveFinished(bool p_succeeded);
     void noticeStatusChanged();
     void handleWebKeyPressed(int p_key, bool p_ctrl, bool p_shift);
+    void handleRenderFinished();
+    // Restart the timer to update the live preview after a typing pause.
+    void requestLivePreview();
+    void renderLivePreview();
+    void handleLiveRenderFinished();
+    // Return the preview view to the pool.
+    void releasePreviewer();
 
 private:
     void setupUI();
     void showFileReadMode();
     void showFileEditMode();
     void setupMarkdownPreview();
+    // Take a view from the pool and load the template if there is none.
+    void ensurePreviewer();
+    // Preview with the cached rendering, or render in background.
     void previewByConverter();
-    void processHoedownToc(QString &p_toc);
+    void applyRender(const VMarkdownRender &p_render);
+    bool isLivePreviewShown() const;
+    // Render the text of @p_snapshot without image preview blocks and split
+    // the HTML into blocks. Run in background.
+    static VMarkdownRender renderSnapshot(const VTextSnapshot &p_snapshot,
+                                          hoedown_extensions p_options);
+    // Update the outline of anchors in read mode.
+    void updateTocFromAnchors(const QVector<VHeader> &p_headers);
     inline bool isChild(QObject *obj);
     void parseTocUl(QXmlStreamReader &xml, QVector<VHeader> &headers, int level);
     void parseTocLi(QXmlStreamReader &xml, QVector<VHeader> &headers, int level);
@@ -98,6 +137,17 @@ private:
     VAnchor curHeader;
     bool m_fileModified;
     VEditArea *m_editArea;
+    int m_loadingProgress;
+    QFutureWatcher<VMarkdownRender> *m_renderWatcher;
+    // Outline index to scroll to after the rendering.
+    int m_renderOutlineIndex;
+    // Page of edit mode holding the editor, and webPreviewer for live preview.
+    QSplitter *m_editSplitter;
+    QTimer *m_livePreviewTimer;
+    QFutureWatcher<VMarkdownRender> *m_liveWatcher;
+    QTimer *m_releasePreviewTimer;
+    // Zoom factor of the preview, kept when the view is released.
+    qreal m_webZoomFactor;
 };
 
 inline bool VEditTab::getIsEditMode() const
@@ -110,6 +160,16 @@ inline bool VEditTab::isModified() const
     return m_textEditor->isModified();
 }
 
+inline int VEditTab::getLoadingProgress() const
+{
+    return m_loadingProgress;
+}
+
+inline const VEdit *VEditTab::getEditor() const
+{
+    return m_textEditor;
+}
+
 inline bool VEditTab::isChild(QObject *obj)
 {
     while (obj) {
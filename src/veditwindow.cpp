@@ -336,7 +336,8 @@ void VEditWindow::updateTabInfo(int p_index)
     bool editMode = editor->getIsEditMode();
 
     setTabText(p_index, generateTabText(p_index, file->getName(),
-                                        file->isModified(), file->isModifiable()));
+                                        file->isModified(), file->isModifiable(),
+                                        editor->getLoadingProgress()));
     setTabToolTip(p_index, generateTooltip(file));
     setTabIcon(p_index, editMode ? QIcon(":/resources/icons/editing.svg") :
                QIcon(":/resources/icons/reading.svg"));
@@ -348,7 +349,8 @@ void VEditWindow::updateAllTabsSequence()
         VEditTab *editor = getTab(i);
         const VFile *file = editor->getFile();
         setTabText(i, generateTabText(i, file->getName(),
-                                      file->isModified(), file->isModifiable()));
+                                      file->isModified(), file->isModifiable(),
+                                      editor->getLoadingProgress()));
     }
 }
 
@@ -96,7 +96,8 @@ private:
     void noticeStatus(int index);
     inline QString generateTooltip(const VFile *p_file) const;
     inline QString generateTabText(int p_index, const QString &p_name,
-                                   bool p_modified, bool p_modifiable) const;
+                                   bool p_modified, bool p_modifiable,
+                                   int p_loadingProgress) const;
     bool canRemoveSplit();
     void moveTabOneSplit(int p_tabIdx, bool p_right);
     void updateTabInfo(int p_idx);
@@ -134,10 +135,15 @@ inline QString VEditWindow::generateTooltip(const VFile *p_file) const
 }
 
 inline QString VEditWindow::generateTabText(int p_index, const QString &p_name,
-                                            bool p_modified, bool p_modifiable) const
+                                            bool p_modified, bool p_modifiable,
+                                            int p_loadingProgress) const
 {
     QString seq = QString::number(p_index + c_tabSequenceBase, 10);
-    return seq + ". " + p_name + (p_modifiable ? (p_modified ? "*" : "") : "#");
+    QString text = seq + ". " + p_name + (p_modifiable ? (p_modified ? "*" : "") : "#");
+    if (p_loadingProgress < 100) {
+        text += QString(" (%1%)").arg(p_loadingProgress);
+    }
+    return text;
 }
 
 #endif // VEDITWINDOW_H
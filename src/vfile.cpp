@@ -3,13 +3,19 @@
 #include <QDir>
 #include <QDebug>
 #include <QTextEdit>
+#include <QCoreApplication>
 #include "utils/vutils.h"
+#include "vnote.h"
+#include "vfilewriter.h"
+
+extern VNote *g_vnote;
 
 VFile::VFile(const QString &p_name, QObject *p_parent,
              FileType p_type, bool p_modifiable)
     : QObject(p_parent), m_name(p_name), m_opened(false), m_modified(false),
       m_docType(VUtils::isMarkdown(p_name) ? DocType::Markdown : DocType::Html),
-      m_type(p_type), m_modifiable(p_modifiable)
+      m_contentLoaded(false), m_saveId(0), m_saveFailed(false), m_type(p_type),
+      m_modifiable(p_modifiable)
 {
 }
 
@@ -27,7 +33,10 @@ bool VFile::open()
     Q_ASSERT(m_docType == (VUtils::isMarkdown(m_name) ? DocType::Markdown : DocType::Html));
     QString path = retrivePath();
     qDebug() << "path" << path;
+    // It may be still being written since last time it is opened.
+    g_vnote->getFileWriter()->waitForFinished();
     m_content = VUtils::readFileFromDisk(path);
+    m_contentLoaded = true;
     m_modified = false;
     m_opened = true;
     qDebug() << "file" << m_name << "opened";
@@ -40,6 +49,8 @@ void VFile::close()
         return;
     }
     m_content.clear();
+    m_contentLoaded = false;
+    m_utf8Content.clear();
     m_opened = false;
 }
 
@@ -53,6 +64,7 @@ void VFile::deleteDiskFile()
     }
 
     // Delete the file
+    g_vnote->getFileWriter()->waitForFinished();
     QString filePath = retrivePath();
     QFile file(filePath);
     if (file.remove()) {
@@ -65,8 +77,42 @@ void VFile::deleteDiskFile()
 bool VFile::save()
 {
     Q_ASSERT(m_opened);
-    bool ret = VUtils::writeFileToDisk(retrivePath(), m_content);
-    return ret;
+    if (m_utf8Content.isNull()) {
+        m_utf8Content = m_content.toUtf8();
+    }
+    // The writer shares the buffer with m_utf8Content until it is done.
+    VFileWriter *writer = g_vnote->getFileWriter();
+    connect(writer, &VFileWriter::fileWritten,
+            this, &VFile::handleFileWritten, Qt::UniqueConnection);
+    m_saveId = writer->writeFile(retrivePath(), m_utf8Content);
+    return true;
+}
+
+void VFile::handleFileWritten(int p_id, const QString &p_filePath, bool p_succeeded)
+{
+    if (p_id != m_saveId) {
+        return;
+    }
+    m_saveId = 0;
+    m_saveFailed = !p_succeeded;
+    if (p_succeeded) {
+        // Do not keep a copy of the content. getContent() will read it back
+        // from disk if needed.
+        m_utf8Content = QByteArray();
+    } else {
+        qWarning() << "fail to save" << p_filePath;
+    }
+    emit saveFinished(p_succeeded);
+}
+
+bool VFile::waitForSaved()
+{
+    if (m_saveId != 0) {
+        g_vnote->getFileWriter()->waitForFinished();
+        // Deliver the queued result to handleFileWritten() now.
+        QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    }
+    return m_saveId == 0 && !m_saveFailed;
 }
 
 void VFile::convert(DocType p_curType, DocType p_targetType)
@@ -77,6 +123,7 @@ void VFile::convert(DocType p_curType, DocType p_targetType)
         return;
     }
     QString path = retrivePath();
+    g_vnote->getFileWriter()->waitForFinished();
     QString fileText = VUtils::readFileFromDisk(path);
     QTextEdit editor;
     if (p_curType == DocType::Markdown) {
@@ -143,6 +190,15 @@ DocType VFile::getDocType() const
 
 const QString &VFile::getContent() const
 {
+    if (!m_contentLoaded && m_opened) {
+        if (m_utf8Content.isNull()) {
+            m_content = VUtils::readFileFromDisk(retrivePath());
+        } else {
+            // Not written to disk yet.
+            m_content = QString::fromUtf8(m_utf8Content);
+        }
+        m_contentLoaded = true;
+    }
     return m_content;
 }
 
@@ -181,6 +237,15 @@ QString VFile::retriveImagePath() const
 void VFile::setContent(const QString &p_content)
 {
     m_content = p_content;
+    m_contentLoaded = true;
+    m_utf8Content = QByteArray();
+}
+
+void VFile::setUtf8Content(const QByteArray &p_data)
+{
+    m_utf8Content = p_data;
+    m_content.clear();
+    m_contentLoaded = false;
 }
 
 bool VFile::isModified() const
@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include <QString>
+#include <QByteArray>
 #include "vdirectory.h"
 #include "vconstants.h"
 
@@ -17,7 +18,13 @@ public:
     virtual ~VFile();
     virtual bool open();
     virtual void close();
+    // Hand the content to the file writer thread. The result will be
+    // reported by saveFinished().
     virtual bool save();
+    // Block until the pending save is done. Returns false if it failed.
+    bool waitForSaved();
+    // Whether a save is handed to the file writer and not done yet.
+    inline bool isSaving() const;
     // Convert current file type.
     virtual void convert(DocType p_curType, DocType p_targetType);
 
@@ -26,8 +33,13 @@ public:
     virtual VDirectory *getDirectory();
     virtual const VDirectory *getDirectory() const;
     DocType getDocType() const;
+    // Return the content of the file. It will be reloaded from disk if it
+    // has been dropped by a save of UTF-8 content.
     const QString &getContent() const;
     virtual void setContent(const QString &p_content);
+    // Set the UTF-8 encoded content to be written by the next save().
+    // The QString copy of the content is dropped.
+    virtual void setUtf8Content(const QByteArray &p_data);
     virtual VNotebook *getNotebook();
     virtual QString getNotebookName() const;
     virtual QString retrivePath() const;
@@ -39,9 +51,15 @@ public:
     bool isOpened() const;
     FileType getType() const;
 
+signals:
+    void saveFinished(bool p_succeeded);
+
 public slots:
     void setModified(bool p_modified);
 
+private slots:
+    void handleFileWritten(int p_id, const QString &p_filePath, bool p_succeeded);
+
 protected:
     // Delete the file and corresponding images
     void deleteDiskFile();
@@ -53,11 +71,25 @@ protected:
     // File has been modified in editor
     bool m_modified;
     DocType m_docType;
-    QString m_content;
+    // Loaded lazily by getContent() if @m_contentLoaded is false.
+    mutable QString m_content;
+    mutable bool m_contentLoaded;
+    // UTF-8 encoded content waiting to be written by save() or being
+    // written by the file writer.
+    QByteArray m_utf8Content;
+    // Id of the write in the file writer, or 0 if no write is pending.
+    int m_saveId;
+    // Whether the last write failed.
+    bool m_saveFailed;
     FileType m_type;
     bool m_modifiable;
 
     friend class VDirectory;
 };
 
+inline bool VFile::isSaving() const
+{
+    return m_saveId != 0;
+}
+
 #endif // VFILE_H
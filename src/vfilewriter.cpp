@@ -0,0 +1,78 @@
+#include "vfilewriter.h"
+#include <QSaveFile>
+#include <QDebug>
+
+VFileWriter::VFileWriter()
+    : QObject(NULL), m_busy(false), m_nextId(0)
+{
+}
+
+int VFileWriter::writeFile(const QString &p_filePath, const QByteArray &p_data)
+{
+    QMutexLocker locker(&m_mutex);
+    int id = ++m_nextId;
+    if (m_requests.contains(p_filePath)) {
+        qDebug() << "coalesce writes of" << p_filePath;
+    } else {
+        m_queue.append(p_filePath);
+    }
+    WriteRequest &req = m_requests[p_filePath];
+    req.m_id = id;
+    req.m_data = p_data;
+
+    if (!m_busy) {
+        m_busy = true;
+        QMetaObject::invokeMethod(this, "processWrites", Qt::QueuedConnection);
+    }
+    return id;
+}
+
+void VFileWriter::processWrites()
+{
+    while (true) {
+        QString filePath;
+        WriteRequest req;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_queue.isEmpty()) {
+                m_busy = false;
+                m_finished.wakeAll();
+                return;
+            }
+            filePath = m_queue.takeFirst();
+            req = m_requests.take(filePath);
+        }
+
+        bool ret = writeFileAtomically(filePath, req.m_data);
+        emit fileWritten(req.m_id, filePath, ret);
+    }
+}
+
+void VFileWriter::waitForFinished()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_busy) {
+        m_finished.wait(&m_mutex);
+    }
+}
+
+bool VFileWriter::writeFileAtomically(const QString &p_filePath, const QByteArray &p_data)
+{
+    QSaveFile file(p_filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "fail to open file" << p_filePath << "to write";
+        return false;
+    }
+    if (file.write(p_data) != p_data.size()) {
+        qWarning() << "fail to write file" << p_filePath << file.errorString();
+        // The target file is left untouched.
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        qWarning() << "fail to commit file" << p_filePath << file.errorString();
+        return false;
+    }
+    qDebug() << "write file content:" << p_filePath << p_data.size() << "bytes";
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef VFILEWRITER_H
+#define VFILEWRITER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+
+// Write files in a dedicated thread. Data is written to a temporary file
+// which then replaces the target, so a crash during writing will not
+// corrupt the file.
+// A write queued while a previous one of the same file is still waiting will
+// replace it, and only the latest one will be reported.
+class VFileWriter : public QObject
+{
+    Q_OBJECT
+public:
+    VFileWriter();
+
+    // Queue a write of @p_data to @p_filePath. Thread-safe.
+    // Returns the id of this write which will be passed to fileWritten().
+    int writeFile(const QString &p_filePath, const QByteArray &p_data);
+
+    // Block until all the queued writes are done.
+    void waitForFinished();
+
+    // Write @p_data to @p_filePath atomically in the calling thread.
+    static bool writeFileAtomically(const QString &p_filePath, const QByteArray &p_data);
+
+signals:
+    // Emitted in the writer thread after a write is done.
+    void fileWritten(int p_id, const QString &p_filePath, bool p_succeeded);
+
+private slots:
+    void processWrites();
+
+private:
+    struct WriteRequest
+    {
+        int m_id;
+        QByteArray m_data;
+    };
+
+    QMutex m_mutex;
+    QWaitCondition m_finished;
+    // Queued writes indexed by file path in the order of queueing.
+    QHash<QString, WriteRequest> m_requests;
+    QStringList m_queue;
+    // Whether processWrites() is scheduled or running.
+    bool m_busy;
+    int m_nextId;
+};
+
+#endif // VFILEWRITER_H
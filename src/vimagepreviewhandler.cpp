@@ -0,0 +1,49 @@
+#include "vimagepreviewhandler.h"
+#include <QPainter>
+#include <QPixmapCache>
+#include <QTextImageFormat>
+#include <QDebug>
+
+VImagePreviewHandler::VImagePreviewHandler(QObject *p_parent)
+    : QObject(p_parent)
+{
+}
+
+QPixmap VImagePreviewHandler::imageOfFormat(const QTextFormat &p_format) const
+{
+    QString name = p_format.toImageFormat().name();
+    QPixmap pixmap;
+    if (name.isEmpty() || QPixmapCache::find(name, &pixmap)) {
+        return pixmap;
+    }
+    if (!pixmap.load(name)) {
+        qWarning() << "fail to load image" << name;
+        return pixmap;
+    }
+    QPixmapCache::insert(name, pixmap);
+    return pixmap;
+}
+
+QSizeF VImagePreviewHandler::intrinsicSize(QTextDocument *p_doc, int p_posInDocument,
+                                           const QTextFormat &p_format)
+{
+    Q_UNUSED(p_doc);
+    Q_UNUSED(p_posInDocument);
+    QPixmap pixmap = imageOfFormat(p_format);
+    if (pixmap.isNull()) {
+        return QSizeF();
+    }
+    return QSizeF(pixmap.size());
+}
+
+void VImagePreviewHandler::drawObject(QPainter *p_painter, const QRectF &p_rect,
+                                      QTextDocument *p_doc, int p_posInDocument,
+                                      const QTextFormat &p_format)
+{
+    Q_UNUSED(p_doc);
+    Q_UNUSED(p_posInDocument);
+    QPixmap pixmap = imageOfFormat(p_format);
+    if (!pixmap.isNull()) {
+        p_painter->drawPixmap(p_rect, pixmap, QRectF(pixmap.rect()));
+    }
+}
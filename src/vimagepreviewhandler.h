@@ -0,0 +1,32 @@
+#ifndef VIMAGEPREVIEWHANDLER_H
+#define VIMAGEPREVIEWHANDLER_H
+
+#include <QObject>
+#include <QTextObjectInterface>
+#include <QSizeF>
+#include <QPixmap>
+
+class QTextDocument;
+class QPainter;
+
+// Draw the images of image preview blocks for the layouts without an image
+// handler, such as QPlainTextDocumentLayout. Images are loaded from the path
+// in the name of the format and shared in QPixmapCache.
+class VImagePreviewHandler : public QObject, public QTextObjectInterface
+{
+    Q_OBJECT
+    Q_INTERFACES(QTextObjectInterface)
+public:
+    explicit VImagePreviewHandler(QObject *p_parent = 0);
+
+    QSizeF intrinsicSize(QTextDocument *p_doc, int p_posInDocument,
+                         const QTextFormat &p_format) Q_DECL_OVERRIDE;
+    void drawObject(QPainter *p_painter, const QRectF &p_rect, QTextDocument *p_doc,
+                    int p_posInDocument, const QTextFormat &p_format) Q_DECL_OVERRIDE;
+
+private:
+    // Returns a null pixmap if the image could not be loaded.
+    QPixmap imageOfFormat(const QTextFormat &p_format) const;
+};
+
+#endif // VIMAGEPREVIEWHANDLER_H
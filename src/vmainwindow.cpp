@@ -1,5 +1,6 @@
 #include <QtWidgets>
 #include <QList>
+#include <QtConcurrent/QtConcurrentRun>
 #include "vmainwindow.h"
 #include "vdirectorytree.h"
 #include "vnote.h"
@@ -13,6 +14,11 @@
 #include "dialog/vfindreplacedialog.h"
 #include "dialog/vsettingsdialog.h"
 #include "vcaptain.h"
+#include "veditjournal.h"
+#include "vmdedit.h"
+#include "vdocstatistics.h"
+#include "vnotebook.h"
+#include "vrendercache.h"
 
 extern VConfigManager vconfig;
 
@@ -40,6 +46,38 @@ VMainWindow::VMainWindow(QWidget *parent)
     notebookSelector->update();
 
     initCaptain();
+
+    checkEditJournals();
+}
+
+void VMainWindow::checkEditJournals()
+{
+    QStringList notes = VEditJournal::recoverableNotes();
+    if (notes.isEmpty()) {
+        return;
+    }
+
+    int ret = VUtils::showMessage(QMessageBox::Information, tr("Information"),
+                                  tr("Unsaved changes of %1 note(s) are found from last session.")
+                                    .arg(notes.size()),
+                                  tr("Do you want to recover them?\n%1").arg(notes.join('\n')),
+                                  QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes, this);
+    QStringList failed;
+    for (int i = 0; i < notes.size(); ++i) {
+        if (ret == QMessageBox::Yes) {
+            if (!VEditJournal::recover(notes[i])) {
+                failed.append(notes[i]);
+            }
+        } else {
+            VEditJournal::removeJournals(notes[i]);
+        }
+    }
+
+    if (!failed.isEmpty()) {
+        VUtils::showMessage(QMessageBox::Warning, tr("Warning"),
+                            tr("Fail to recover %1 note(s).").arg(failed.size()),
+                            failed.join('\n'), QMessageBox::Ok, QMessageBox::Ok, this);
+    }
 }
 
 void VMainWindow::initCaptain()
@@ -103,7 +141,8 @@ void VMainWindow::setupUI()
 
     setCentralWidget(mainSplitter);
     // Create and show the status bar
-    statusBar();
+    m_docStatLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(m_docStatLabel);
 }
 
 QWidget *VMainWindow::setupDirectoryPanel()
@@ -296,7 +335,13 @@ void VMainWindow::initHelpMenu()
     connect(aboutQtAct, &QAction::triggered,
             qApp, &QApplication::aboutQt);
 
+    QAction *undoMemoryAct = new QAction(tr("&Undo Memory Usage"), this);
+    undoMemoryAct->setToolTip(tr("View the memory used by the undo history of each tab"));
+    connect(undoMemoryAct, &QAction::triggered,
+            this, &VMainWindow::viewUndoMemory);
+
     helpMenu->addAction(shortcutAct);
+    helpMenu->addAction(undoMemoryAct);
     helpMenu->addAction(aboutQtAct);
     helpMenu->addAction(aboutAct);
 }
@@ -367,6 +412,28 @@ void VMainWindow::initMarkdownMenu()
     markdownMenu->addAction(mathjaxAct);
 
     mathjaxAct->setChecked(vconfig.getEnableMathjax());
+
+    markdownMenu->addSeparator();
+    QAction *livePreviewAct = new QAction(tr("&Live Preview"), this);
+    livePreviewAct->setToolTip(tr("Preview beside the editor in edit mode (Hoedown only)"));
+    livePreviewAct->setCheckable(true);
+    connect(livePreviewAct, &QAction::triggered,
+            this, &VMainWindow::enableLivePreview);
+    markdownMenu->addAction(livePreviewAct);
+
+    livePreviewAct->setChecked(vconfig.getLivePreview());
+
+    m_warmRenderCacheAct = new QAction(tr("&Warm Render Cache"), this);
+    m_warmRenderCacheAct->setToolTip(tr("Render all the notes of current notebook in background "
+                                        "to preview them faster (Hoedown only)"));
+    connect(m_warmRenderCacheAct, &QAction::triggered,
+            this, &VMainWindow::warmRenderCache);
+    markdownMenu->addAction(m_warmRenderCacheAct);
+    m_warmRenderCacheAct->setEnabled(false);
+
+    m_warmRenderCacheWatcher = new QFutureWatcher<int>(this);
+    connect(m_warmRenderCacheWatcher, &QFutureWatcher<int>::finished,
+            this, &VMainWindow::handleWarmRenderCacheFinished);
 }
 
 void VMainWindow::initViewMenu()
@@ -514,10 +581,38 @@ void VMainWindow::initEditMenu()
     connect(selectedWordAct, &QAction::triggered,
             this, &VMainWindow::changeHighlightSelectedWord);
 
+    // Folding.
+    m_toggleFoldAct = new QAction(tr("Fold/Unfold"), this);
+    m_toggleFoldAct->setToolTip(tr("Fold or unfold current section or code block"));
+    m_toggleFoldAct->setShortcut(QKeySequence("Ctrl+Alt+["));
+    connect(m_toggleFoldAct, &QAction::triggered,
+            this, &VMainWindow::toggleFold);
+
+    m_foldOthersAct = new QAction(tr("Fold Other Sections"), this);
+    m_foldOthersAct->setToolTip(tr("Fold all the sections except current one"));
+    m_foldOthersAct->setShortcut(QKeySequence("Ctrl+Alt+-"));
+    connect(m_foldOthersAct, &QAction::triggered,
+            this, &VMainWindow::foldOtherSections);
+
+    m_unfoldAllAct = new QAction(tr("Unfold All"), this);
+    m_unfoldAllAct->setToolTip(tr("Unfold all the sections and code blocks"));
+    m_unfoldAllAct->setShortcut(QKeySequence("Ctrl+Alt+]"));
+    connect(m_unfoldAllAct, &QAction::triggered,
+            this, &VMainWindow::unfoldAll);
+
     editMenu->addAction(m_insertImageAct);
     editMenu->addSeparator();
     m_insertImageAct->setEnabled(false);
 
+    QMenu *foldMenu = editMenu->addMenu(tr("Folding"));
+    foldMenu->setToolTipsVisible(true);
+    foldMenu->addAction(m_toggleFoldAct);
+    foldMenu->addAction(m_foldOthersAct);
+    foldMenu->addAction(m_unfoldAllAct);
+    m_toggleFoldAct->setEnabled(false);
+    m_foldOthersAct->setEnabled(false);
+    m_unfoldAllAct->setEnabled(false);
+
     QMenu *findReplaceMenu = editMenu->addMenu(tr("Find/Replace"));
     findReplaceMenu->setToolTipsVisible(true);
     findReplaceMenu->addAction(m_findReplaceAct);
@@ -663,6 +758,32 @@ void VMainWindow::aboutMessage()
     QMessageBox::about(this, tr("About VNote"), info);
 }
 
+void VMainWindow::viewUndoMemory()
+{
+    QVector<VEditTab *> tabs = editArea->getAllTabs();
+    qint64 total = 0;
+    QString info;
+    for (int i = 0; i < tabs.size(); ++i) {
+        const VEdit *editor = tabs[i]->getEditor();
+        total += editor->getUndoMemory();
+        info += tr("%1: %2 KB in %3 step(s)").arg(tabs[i]->getFile()->getName())
+                                              .arg(editor->getUndoMemory() / 1024)
+                                              .arg(editor->getUndoSteps());
+        info += "\n";
+    }
+
+    int budget = vconfig.getUndoMemoryBudget();
+    QString text = tr("Undo history of %1 tab(s) uses %2 KB.").arg(tabs.size()).arg(total / 1024);
+    text += "\n";
+    if (budget > 0) {
+        text += tr("The budget of each note is %1 MB.").arg(budget);
+    } else {
+        text += tr("The undo history is not limited.");
+    }
+    VUtils::showMessage(QMessageBox::Information, tr("Undo Memory Usage"), text, info,
+                        QMessageBox::Ok, QMessageBox::Ok, this);
+}
+
 void VMainWindow::changeExpandTab(bool checked)
 {
     vconfig.setIsExpandTab(checked);
@@ -678,6 +799,15 @@ void VMainWindow::enableMathjax(bool p_checked)
     vconfig.setEnableMathjax(p_checked);
 }
 
+void VMainWindow::enableLivePreview(bool p_checked)
+{
+    vconfig.setLivePreview(p_checked);
+    QVector<VEditTab *> tabs = editArea->getAllTabs();
+    for (int i = 0; i < tabs.size(); ++i) {
+        tabs[i]->updateLivePreview();
+    }
+}
+
 void VMainWindow::changeHighlightCursorLine(bool p_checked)
 {
     vconfig.setHighlightCursorLine(p_checked);
@@ -811,6 +941,10 @@ void VMainWindow::updateActionStateFromTabStatusChange(const VFile *p_file,
     noteInfoAct->setEnabled(p_file && p_file->getType() == FileType::Normal);
 
     m_insertImageAct->setEnabled(p_file && p_editMode);
+    bool canFold = p_file && p_editMode && p_file->getDocType() == DocType::Markdown;
+    m_toggleFoldAct->setEnabled(canFold);
+    m_foldOthersAct->setEnabled(canFold);
+    m_unfoldAllAct->setEnabled(canFold);
     // Find/Replace
     m_findReplaceAct->setEnabled(p_file);
     m_findNextAct->setEnabled(p_file);
@@ -844,7 +978,41 @@ void VMainWindow::handleCurTabStatusChanged(const VFile *p_file, const VEditTab
     }
     updateWindowTitle(title);
     m_curFile = const_cast<VFile *>(p_file);
-    m_curTab = const_cast<VEditTab *>(p_editTab);
+    if (m_curTab != p_editTab) {
+        if (m_curTab) {
+            disconnect((VEditTab *)m_curTab, &VEditTab::statisticsChanged,
+                       this, &VMainWindow::updateDocStatistics);
+        }
+        m_curTab = const_cast<VEditTab *>(p_editTab);
+        if (m_curTab) {
+            connect((VEditTab *)m_curTab, &VEditTab::statisticsChanged,
+                    this, &VMainWindow::updateDocStatistics);
+        }
+    }
+    updateDocStatistics();
+}
+
+void VMainWindow::updateDocStatistics()
+{
+    const VMdEdit *editor = m_curTab ? dynamic_cast<const VMdEdit *>(m_curTab->getEditor())
+                                     : NULL;
+    if (!editor) {
+        m_docStatLabel->clear();
+        return;
+    }
+
+    const VDocStatistics *stat = editor->getStatistics();
+    const VTextCounts &total = stat->getTotal();
+    QString info = tr("%1 words, %2 characters, %3 lines, %4 min read")
+                     .arg(total.m_words).arg(total.m_chars).arg(total.m_lines)
+                     .arg(VDocStatistics::readingMinutes(total));
+    QTextCursor cursor = editor->textCursor();
+    if (cursor.hasSelection()) {
+        VTextCounts sel = stat->countRange(cursor.selectionStart(), cursor.selectionEnd());
+        info = tr("Selected %1 words, %2 characters | %3").arg(sel.m_words)
+                                                          .arg(sel.m_chars).arg(info);
+    }
+    m_docStatLabel->setText(info);
 }
 
 void VMainWindow::onePanelView()
@@ -986,6 +1154,40 @@ void VMainWindow::handleCurrentDirectoryChanged(const VDirectory *p_dir)
 void VMainWindow::handleCurrentNotebookChanged(const VNotebook *p_notebook)
 {
     newRootDirAct->setEnabled(p_notebook);
+    m_curNotebook = const_cast<VNotebook *>(p_notebook);
+    m_warmRenderCacheAct->setEnabled(p_notebook && !m_warmRenderCacheWatcher->isRunning());
+}
+
+void VMainWindow::warmRenderCache()
+{
+    if (!m_curNotebook || m_warmRenderCacheWatcher->isRunning()) {
+        return;
+    }
+    if (vconfig.getMdConverterType() != MarkdownConverterType::Hoedown
+        || vconfig.getRenderCacheSize() <= 0) {
+        VUtils::showMessage(QMessageBox::Information, tr("Information"),
+                            tr("Render cache is used only by Hoedown converter."),
+                            tr("Please choose Hoedown converter and set a size limit of "
+                               "the render cache to use it."),
+                            QMessageBox::Ok, QMessageBox::Ok, this);
+        return;
+    }
+    m_warmRenderCacheNotebook = m_curNotebook->getName();
+    m_warmRenderCacheAct->setEnabled(false);
+    statusBar()->showMessage(tr("Warming render cache of notebook %1...")
+                               .arg(m_warmRenderCacheNotebook));
+    m_warmRenderCacheWatcher->setFuture(QtConcurrent::run(&VRenderCache::warmNotebook,
+                                                          m_curNotebook->getPath(),
+                                                          vconfig.getMarkdownExtensions(),
+                                                          vconfig.getRenderCacheSize()));
+}
+
+void VMainWindow::handleWarmRenderCacheFinished()
+{
+    m_warmRenderCacheAct->setEnabled(m_curNotebook);
+    showStatusMessage(tr("Render cache of notebook %1 warmed: %2 note(s) rendered")
+                        .arg(m_warmRenderCacheNotebook)
+                        .arg(m_warmRenderCacheWatcher->result()));
 }
 
 void VMainWindow::resizeEvent(QResizeEvent *event)
@@ -1028,6 +1230,27 @@ void VMainWindow::insertImage()
     m_curTab->insertImage();
 }
 
+void VMainWindow::toggleFold()
+{
+    if (m_curTab) {
+        m_curTab->toggleFold();
+    }
+}
+
+void VMainWindow::foldOtherSections()
+{
+    if (m_curTab) {
+        m_curTab->foldOtherSections();
+    }
+}
+
+void VMainWindow::unfoldAll()
+{
+    if (m_curTab) {
+        m_curTab->unfoldAll();
+    }
+}
+
 void VMainWindow::locateFile(VFile *p_file)
 {
     if (!p_file || p_file->getType() != FileType::Normal) {
@@ -1059,6 +1282,12 @@ void VMainWindow::locateCurrentFile()
     }
 }
 
+void VMainWindow::showStatusMessage(const QString &p_msg)
+{
+    const int timeout = 3000;
+    statusBar()->showMessage(p_msg, timeout);
+}
+
 void VMainWindow::handleFindDialogTextChanged(const QString &p_text, uint /* p_options */)
 {
     bool enabled = true;
@@ -6,6 +6,7 @@
 #include <QPair>
 #include <QPointer>
 #include <QString>
+#include <QFutureWatcher>
 #include "vfile.h"
 #include "vedittab.h"
 
@@ -41,6 +42,8 @@ public:
     const QVector<QPair<QString, QString> > &getPalette() const;
     void locateFile(VFile *p_file);
     void locateCurrentFile();
+    // Show @p_msg in the status bar for a while.
+    void showStatusMessage(const QString &p_msg);
 
 private slots:
     void importNoteFromFile();
@@ -48,6 +51,10 @@ private slots:
     void changeMarkdownConverter(QAction *action);
     void aboutMessage();
     void shortcutHelp();
+    // Show the memory used by the undo history of each tab.
+    void viewUndoMemory();
+    // Show the counts of current note in the status bar.
+    void updateDocStatistics();
     void changeExpandTab(bool checked);
     void setTabStopWidth(QAction *action);
     void setEditorBackgroundColor(QAction *action);
@@ -64,10 +71,18 @@ private slots:
     void handleCurrentDirectoryChanged(const VDirectory *p_dir);
     void handleCurrentNotebookChanged(const VNotebook *p_notebook);
     void insertImage();
+    void toggleFold();
+    void foldOtherSections();
+    void unfoldAll();
     void handleFindDialogTextChanged(const QString &p_text, uint p_options);
     void openFindDialog();
     void enableMermaid(bool p_checked);
     void enableMathjax(bool p_checked);
+    void enableLivePreview(bool p_checked);
+    // Render the notes of current notebook into the render cache in
+    // background.
+    void warmRenderCache();
+    void handleWarmRenderCacheFinished();
     void handleCaptainModeChanged(bool p_enabled);
     void changeAutoIndent(bool p_checked);
     void changeAutoList(bool p_checked);
@@ -106,12 +121,15 @@ private:
     void repositionAvatar();
 
     void initCaptain();
+    // Recover unsaved changes from the journals of last session.
+    void checkEditJournals();
     void toggleOnePanelView();
     void closeCurrentFile();
 
     VNote *vnote;
     QPointer<VFile> m_curFile;
     QPointer<VEditTab> m_curTab;
+    QPointer<VNotebook> m_curNotebook;
 
     VCaptain *m_captain;
 
@@ -127,6 +145,7 @@ private:
     VOutline *outline;
     VAvatar *m_avatar;
     VFindReplaceDialog *m_findReplaceDialog;
+    QLabel *m_docStatLabel;
 
     // Whether it is one panel or two panles.
     bool m_onePanel;
@@ -144,6 +163,9 @@ private:
     QAction *m_importNoteAct;
 
     QAction *m_insertImageAct;
+    QAction *m_toggleFoldAct;
+    QAction *m_foldOthersAct;
+    QAction *m_unfoldAllAct;
     QAction *m_findReplaceAct;
     QAction *m_findNextAct;
     QAction *m_findPreviousAct;
@@ -152,6 +174,11 @@ private:
     QAction *m_replaceAllAct;
 
     QAction *m_autoIndentAct;
+    QAction *m_warmRenderCacheAct;
+
+    QFutureWatcher<int> *m_warmRenderCacheWatcher;
+    // Name of the notebook whose render cache is being warmed.
+    QString m_warmRenderCacheNotebook;
 
     // Menus
     QMenu *viewMenu;
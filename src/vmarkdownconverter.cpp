@@ -1,52 +1,331 @@
 #include "vmarkdownconverter.h"
+#include <QRegExp>
+#include <QThreadStorage>
+#include <QRegularExpression>
+#include <QCache>
+#include <QMutex>
+#include <QDebug>
+
+// Unit to grow the output buffer.
+static const size_t c_outBufUnit = 64 * 1024;
+// Output buffer larger than this is freed if the last rendering used less
+// than a quarter of it.
+static const size_t c_outBufKeepSize = 4 * 1024 * 1024;
+// Total size in KB of the HTML in the cache of recent renderings.
+static const int c_renderCacheCost = 32 * 1024;
+
+// Elements without end tags.
+static const char *c_voidElements[] = {"area", "base", "br", "col", "embed", "hr", "img",
+                                       "input", "link", "meta", "param", "source",
+                                       "track", "wbr", NULL};
+
+static bool isVoidElement(const QString &p_name)
+{
+    for (int i = 0; c_voidElements[i]; ++i) {
+        if (p_name.compare(c_voidElements[i], Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Entry of the cache of recent renderings. Keys may collide, so the markdown
+// is kept to be compared.
+struct VCachedRender
+{
+    QString m_markdown;
+    VMarkdownRender m_render;
+};
+
+static QMutex s_renderCacheMutex;
+static QCache<QString, VCachedRender> s_renderCache(c_renderCacheCost);
 
 VMarkdownConverter::VMarkdownConverter()
+    : m_document(NULL), m_extensions((hoedown_extensions)0), m_headers(NULL)
 {
     hoedownHtmlFlags = (hoedown_html_flags)0;
     nestingLevel = 16;
 
     htmlRenderer = hoedown_html_renderer_new(hoedownHtmlFlags, nestingLevel);
-    tocRenderer = hoedown_html_toc_renderer_new(nestingLevel);
+    // The HTML renderer writes "toc_<N>" ids to headers, which is the anchor
+    // of the TOC. Hook it to collect the headers in the same pass.
+    hoedown_html_renderer_state *state = (hoedown_html_renderer_state *)htmlRenderer->opaque;
+    state->opaque = this;
+    m_htmlHeader = htmlRenderer->header;
+    htmlRenderer->header = &VMarkdownConverter::renderHeader;
+
+    m_outBuf = hoedown_buffer_new(c_outBufUnit);
 }
 
 VMarkdownConverter::~VMarkdownConverter()
 {
+    if (m_document) {
+        hoedown_document_free(m_document);
+    }
+    hoedown_buffer_free(m_outBuf);
     if (htmlRenderer) {
         hoedown_html_renderer_free(htmlRenderer);
     }
-    if (tocRenderer) {
-        hoedown_html_renderer_free(tocRenderer);
-    }
 }
 
-QString VMarkdownConverter::generateHtml(const QString &markdown, hoedown_extensions options)
+QString VMarkdownConverter::generateHtml(const QString &markdown, hoedown_extensions options,
+                                         QVector<VHeader> *p_headers)
 {
+    if (p_headers) {
+        p_headers->clear();
+    }
     if (markdown.isEmpty()) {
         return QString();
     }
-    hoedown_document *document = hoedown_document_new(htmlRenderer, options,
-                                                      nestingLevel);
+    // Header ids count from 0 for each document.
+    hoedown_html_renderer_state *state = (hoedown_html_renderer_state *)htmlRenderer->opaque;
+    state->toc_data.header_count = 0;
+    state->toc_data.current_level = 0;
+    state->toc_data.level_offset = 0;
+    m_headers = p_headers;
+
+    if (!m_document || options != m_extensions) {
+        if (m_document) {
+            hoedown_document_free(m_document);
+        }
+        m_document = hoedown_document_new(htmlRenderer, options, nestingLevel);
+        m_extensions = options;
+    }
+
     QByteArray data = markdown.toUtf8();
-    hoedown_buffer *outBuf = hoedown_buffer_new(data.size());
-    hoedown_document_render(document, outBuf, (const uint8_t *)data.constData(), data.size());
-    hoedown_document_free(document);
-    QString html = QString::fromUtf8(hoedown_buffer_cstr(outBuf));
-    hoedown_buffer_free(outBuf);
+    // Keep the allocated memory of the buffer.
+    m_outBuf->size = 0;
+    hoedown_buffer_grow(m_outBuf, data.size());
+    hoedown_document_render(m_document, m_outBuf, (const uint8_t *)data.constData(),
+                            data.size());
+    QString html = QString::fromUtf8((const char *)m_outBuf->data, m_outBuf->size);
+    if (m_outBuf->asize > c_outBufKeepSize && m_outBuf->size < m_outBuf->asize / 4) {
+        hoedown_buffer_free(m_outBuf);
+        m_outBuf = hoedown_buffer_new(c_outBufUnit);
+    }
 
+    m_headers = NULL;
+    if (p_headers) {
+        adjustHeaderLevels(*p_headers);
+    }
     return html;
 }
 
-QString VMarkdownConverter::generateToc(const QString &markdown, hoedown_extensions options)
+VMarkdownConverter *VMarkdownConverter::threadConverter()
 {
-    if (markdown.isEmpty()) {
-        return QString();
+    static QThreadStorage<VMarkdownConverter *> converters;
+    if (!converters.hasLocalData()) {
+        converters.setLocalData(new VMarkdownConverter());
+    }
+    return converters.localData();
+}
+
+void VMarkdownConverter::renderHeader(hoedown_buffer *p_ob, const hoedown_buffer *p_content,
+                                      int p_level, const hoedown_renderer_data *p_data)
+{
+    hoedown_html_renderer_state *state = (hoedown_html_renderer_state *)p_data->opaque;
+    VMarkdownConverter *converter = (VMarkdownConverter *)state->opaque;
+    int id = state->toc_data.header_count;
+    converter->m_htmlHeader(p_ob, p_content, p_level, p_data);
+    if (!converter->m_headers || p_level > state->toc_data.nesting_level) {
+        return;
+    }
+
+    // Title in plain text. Hoedown will translate `_` in title to <em>.
+    QString name;
+    if (p_content) {
+        name = QString::fromUtf8((const char *)p_content->data, p_content->size);
+        name.replace("<em>", "_");
+        name.replace("</em>", "_");
+        name.remove(QRegExp("<[^>]*>"));
+        name.replace("&lt;", "<");
+        name.replace("&gt;", ">");
+        name.replace("&quot;", "\"");
+        name.replace("&#39;", "'");
+        name.replace("&#47;", "/");
+        name.replace("&amp;", "&");
+    }
+    converter->m_headers->append(VHeader(p_level, name, QString("#toc_%1").arg(id), -1));
+}
+
+void VMarkdownConverter::adjustHeaderLevels(QVector<VHeader> &p_headers)
+{
+    if (p_headers.isEmpty()) {
+        return;
+    }
+    QVector<VHeader> headers;
+    headers.reserve(p_headers.size());
+    int offset = p_headers[0].level - 1;
+    int curLevel = 0;
+    for (int i = 0; i < p_headers.size(); ++i) {
+        VHeader header = p_headers[i];
+        header.level = qMax(header.level - offset, 1);
+        // Such as header 3 under header 1 directly.
+        while (curLevel + 1 < header.level) {
+            ++curLevel;
+            headers.append(VHeader(curLevel, "[EMPTY]", "#", -1));
+        }
+        curLevel = header.level;
+        headers.append(header);
+    }
+    p_headers = headers;
+}
+
+QString VMarkdownConverter::generateToc(const QVector<VHeader> &p_headers)
+{
+    QString toc;
+    int curLevel = 0;
+    for (int i = 0; i < p_headers.size(); ++i) {
+        const VHeader &header = p_headers[i];
+        if (header.level > curLevel) {
+            while (header.level > curLevel) {
+                toc += "<ul><li>";
+                ++curLevel;
+            }
+        } else if (header.level < curLevel) {
+            toc += "</li>";
+            while (header.level < curLevel) {
+                toc += "</ul></li>";
+                --curLevel;
+            }
+            toc += "<li>";
+        } else {
+            toc += "</li><li>";
+        }
+
+        if (header.anchor != "#") {
+            toc += QString("<a href=\"%1\">%2</a>").arg(header.anchor)
+                                                    .arg(header.name.toHtmlEscaped());
+        }
+    }
+    while (curLevel > 0) {
+        toc += "</li></ul>";
+        --curLevel;
     }
-    hoedown_document *document = hoedown_document_new(tocRenderer, options, nestingLevel);
-    QByteArray data = markdown.toUtf8();
-    hoedown_buffer *outBuf = hoedown_buffer_new(16);
-    hoedown_document_render(document, outBuf, (const uint8_t *)data.constData(), data.size());
-    hoedown_document_free(document);
-    QString toc = QString::fromUtf8(hoedown_buffer_cstr(outBuf));
-    hoedown_buffer_free(outBuf);
     return toc;
 }
+
+QString VMarkdownConverter::renderKey(const QString &p_markdown, hoedown_extensions p_options)
+{
+    return QString("%1_%2_%3").arg(qHash(p_markdown))
+                              .arg(p_markdown.size())
+                              .arg((int)p_options);
+}
+
+VMarkdownRender VMarkdownConverter::render(const QString &p_markdown,
+                                           hoedown_extensions p_options)
+{
+    VMarkdownRender result;
+    if (findRender(p_markdown, p_options, result)) {
+        return result;
+    }
+
+    result = generateRender(p_markdown, p_options);
+    insertRender(p_markdown, p_options, result);
+    return result;
+}
+
+VMarkdownRender VMarkdownConverter::generateRender(const QString &p_markdown,
+                                                   hoedown_extensions p_options)
+{
+    VMarkdownRender result;
+    result.m_html = threadConverter()->generateHtml(p_markdown, p_options,
+                                                    &result.m_headers);
+    QRegularExpression tocExp("<p>\\[TOC\\]<\\/p>", QRegularExpression::CaseInsensitiveOption);
+    if (result.m_html.contains(tocExp)) {
+        result.m_html.replace(tocExp, generateToc(result.m_headers));
+    }
+    return result;
+}
+
+void VMarkdownConverter::insertRender(const QString &p_markdown, hoedown_extensions p_options,
+                                      const VMarkdownRender &p_render)
+{
+    QString key = renderKey(p_markdown, p_options);
+    VCachedRender *entry = new VCachedRender();
+    entry->m_markdown = p_markdown;
+    entry->m_render = p_render;
+    int cost = (p_render.m_html.size() + p_markdown.size()) / 1024 + 1;
+    QMutexLocker locker(&s_renderCacheMutex);
+    s_renderCache.insert(key, entry, cost);
+}
+
+bool VMarkdownConverter::findRender(const QString &p_markdown, hoedown_extensions p_options,
+                                    VMarkdownRender &p_render)
+{
+    QString key = renderKey(p_markdown, p_options);
+    QMutexLocker locker(&s_renderCacheMutex);
+    VCachedRender *cached = s_renderCache.object(key);
+    if (!cached || cached->m_markdown != p_markdown) {
+        return false;
+    }
+    p_render = cached->m_render;
+    return true;
+}
+
+QStringList VMarkdownConverter::splitBlocks(const QString &p_html)
+{
+    QStringList blocks;
+    int size = p_html.size();
+    int depth = 0;
+    // Start of current block.
+    int start = -1;
+    int i = 0;
+    while (i < size) {
+        if (p_html[i] != '<') {
+            if (start == -1 && !p_html[i].isSpace()) {
+                start = i;
+            }
+            ++i;
+            continue;
+        }
+
+        int end;
+        if (p_html.midRef(i, 4) == "<!--") {
+            end = p_html.indexOf("-->", i + 4);
+            end = end == -1 ? size : end + 3;
+            if (start == -1) {
+                start = i;
+            }
+        } else {
+            end = p_html.indexOf('>', i);
+            if (end == -1) {
+                end = size;
+                break;
+            }
+            ++end;
+            bool closing = i + 1 < size && p_html[i + 1] == '/';
+            int nameStart = closing ? i + 2 : i + 1;
+            int nameEnd = nameStart;
+            while (nameEnd < end && p_html[nameEnd].isLetterOrNumber()) {
+                ++nameEnd;
+            }
+            QString name = p_html.mid(nameStart, nameEnd - nameStart);
+            if (start == -1) {
+                start = i;
+            }
+            if (closing) {
+                if (--depth < 0) {
+                    break;
+                }
+            } else if (p_html[end - 2] != '/' && !isVoidElement(name)) {
+                ++depth;
+            }
+        }
+
+        i = end;
+        if (depth == 0 && start != -1) {
+            blocks.append(p_html.mid(start, i - start));
+            start = -1;
+        }
+    }
+
+    if (depth != 0 || i < size) {
+        qDebug() << "fail to split HTML into blocks" << depth << i << size;
+        return QStringList(p_html);
+    }
+    if (start != -1) {
+        blocks.append(p_html.mid(start));
+    }
+    return blocks;
+}
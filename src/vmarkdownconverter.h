@@ -2,27 +2,95 @@
 #define VMARKDOWNCONVERTER_H
 
 #include <QString>
+#include <QVector>
+#include <QStringList>
+#include "vtoc.h"
+
+// HTML of a note with [TOC] replaced, and its headers.
+struct VMarkdownRender
+{
+    QString m_html;
+    QVector<VHeader> m_headers;
+    // Top-level blocks of m_html for live preview. Empty unless requested.
+    QStringList m_blocks;
+};
 
 extern "C" {
 #include <src/html.h>
 #include <src/document.h>
 }
 
+// Not thread-safe. Use threadConverter() to get one for each thread.
 class VMarkdownConverter
 {
 public:
     VMarkdownConverter();
     ~VMarkdownConverter();
 
-    QString generateHtml(const QString &markdown, hoedown_extensions options);
-    QString generateToc(const QString &markdown, hoedown_extensions options);
+    // The converter of current thread, which keeps its renderer, document and
+    // buffers for the following renderings.
+    static VMarkdownConverter *threadConverter();
+
+    // Render @markdown in one pass. If @p_headers is not NULL, it will hold
+    // the headers in the same form as parsed from Hoedown's TOC, with the
+    // anchors of the header ids in the HTML.
+    QString generateHtml(const QString &markdown, hoedown_extensions options,
+                         QVector<VHeader> *p_headers = NULL);
+
+    // Generate the TOC HTML of @p_headers like Hoedown's TOC renderer does.
+    static QString generateToc(const QVector<VHeader> &p_headers);
+
+    // Render @p_markdown with threadConverter() and keep the result in a cache
+    // of recent renderings. Thread-safe.
+    static VMarkdownRender render(const QString &p_markdown, hoedown_extensions p_options);
+
+    // Render @p_markdown with threadConverter() without the cache, such as for
+    // the intermediate text of live preview. Thread-safe.
+    static VMarkdownRender generateRender(const QString &p_markdown,
+                                          hoedown_extensions p_options);
+
+    // Add @p_render of @p_markdown to the cache of recent renderings.
+    // Thread-safe.
+    static void insertRender(const QString &p_markdown, hoedown_extensions p_options,
+                             const VMarkdownRender &p_render);
+
+    // Look up the cache of recent renderings for exactly @p_markdown.
+    // Thread-safe.
+    static bool findRender(const QString &p_markdown, hoedown_extensions p_options,
+                           VMarkdownRender &p_render);
+
+    // Split @p_html into its top-level elements, dropping the white spaces in
+    // between. Returns @p_html as one block if the tags are not balanced.
+    static QStringList splitBlocks(const QString &p_html);
 
 private:
-    // VMarkdownDocument *generateDocument(const QString &markdown);
+    typedef void (*HeaderCallback)(hoedown_buffer *, const hoedown_buffer *, int,
+                                   const hoedown_renderer_data *);
+
+    // Header callback of htmlRenderer which records the header after the
+    // original callback renders it.
+    static void renderHeader(hoedown_buffer *p_ob, const hoedown_buffer *p_content,
+                             int p_level, const hoedown_renderer_data *p_data);
+
+    // Make the levels relative to the first header and fill the skipped levels
+    // with empty headers.
+    static void adjustHeaderLevels(QVector<VHeader> &p_headers);
+
+    // Key of the cache from the hash of @p_markdown and @p_options. Different
+    // markdown may have the same key.
+    static QString renderKey(const QString &p_markdown, hoedown_extensions p_options);
+
     hoedown_html_flags hoedownHtmlFlags;
     int nestingLevel;
     hoedown_renderer *htmlRenderer;
-    hoedown_renderer *tocRenderer;
+    HeaderCallback m_htmlHeader;
+    // Reused while the extensions do not change.
+    hoedown_document *m_document;
+    hoedown_extensions m_extensions;
+    // Output buffer which keeps its capacity between renderings.
+    hoedown_buffer *m_outBuf;
+    // Headers of current rendering.
+    QVector<VHeader> *m_headers;
 };
 
 #endif // VMARKDOWNCONVERTER_H
@@ -1,6 +1,11 @@
 #include <QtWidgets>
 #include "vmdedit.h"
 #include "hgmarkdownhighlighter.h"
+#include "veditjournal.h"
+#include "vdocstatistics.h"
+#ifdef VNOTE_PLAIN_TEXT_EDITOR
+#include "vimagepreviewhandler.h"
+#endif
 #include "vmdeditoperations.h"
 #include "vnote.h"
 #include "vconfigmanager.h"
@@ -13,12 +18,44 @@ extern VNote *g_vnote;
 
 enum ImageProperty { ImagePath = 1 };
 
+// Files larger than this (in characters) are loaded progressively.
+static const int c_progressiveLoadSize = 2 * 1024 * 1024;
+// Size of each chunk appended to the document.
+static const int c_loadChunkSize = 256 * 1024;
+// Time slice in ms to append chunks before yielding to the event loop.
+static const int c_loadTimeSlice = 20;
+// Pasted text larger than this in characters is inserted in time slices.
+static const int c_chunkedPasteSize = 1024 * 1024;
+
+VImagePreviewBlockData::VImagePreviewBlockData(const QTextBlock &p_block,
+                                               VImagePreviewBlockSet *p_set)
+    : m_block(p_block), m_set(p_set)
+{
+    m_set->insert(this);
+}
+
+VImagePreviewBlockData::~VImagePreviewBlockData()
+{
+    if (m_set) {
+        m_set->remove(this);
+    }
+}
+
 VMdEdit::VMdEdit(VFile *p_file, QWidget *p_parent)
-    : VEdit(p_file, p_parent), m_mdHighlighter(NULL), m_previewImage(true)
+    : VEdit(p_file, p_parent), m_mdHighlighter(NULL), m_previewImage(true),
+      m_dirtyStart(-1), m_dirtyEnd(-1), m_loadedSize(0), m_loadingProgress(100),
+      m_editAfterLoading(false), m_pastedSize(0), m_pastePos(0), m_pasteProgress(NULL),
+      m_discardJournalAfterSave(false)
 {
     Q_ASSERT(p_file->getDocType() == DocType::Markdown);
 
+#ifdef VNOTE_PLAIN_TEXT_EDITOR
+    // QPlainTextDocumentLayout has no handler to draw images.
+    document()->documentLayout()->registerHandler(QTextFormat::ImageObject,
+                                                  new VImagePreviewHandler(this));
+#else
     setAcceptRichText(false);
+#endif
     m_mdHighlighter = new HGMarkdownHighlighter(vconfig.getMdHighlightingStyles(),
                                                 500, document());
     connect(m_mdHighlighter, &HGMarkdownHighlighter::highlightCompleted,
@@ -31,16 +68,51 @@ VMdEdit::VMdEdit(VFile *p_file, QWidget *p_parent)
 
     connect(this, &VMdEdit::cursorPositionChanged,
             this, &VMdEdit::updateCurHeader);
+    connect(this, &VMdEdit::cursorPositionChanged,
+            this, &VMdEdit::unfoldCursorBlock);
 
     connect(this, &VMdEdit::selectionChanged,
             this, &VMdEdit::handleSelectionChanged);
     connect(QApplication::clipboard(), &QClipboard::changed,
             this, &VMdEdit::handleClipboardChanged);
+    m_journal = new VEditJournal(this);
+    connect((VFile *)m_file, &VFile::saveFinished,
+            this, &VMdEdit::handleSaveFinished);
+    connect(document(), &QTextDocument::contentsChange,
+            this, &VMdEdit::handleContentsChange);
+
+    m_statistics = new VDocStatistics(document(), this);
+    connect(m_statistics, &VDocStatistics::countsChanged,
+            this, &VMdEdit::statisticsChanged);
+    connect(this, &VMdEdit::selectionChanged,
+            this, &VMdEdit::statisticsChanged);
+
+    m_snapshotTracker = new VTextSnapshotTracker(document(), this);
+
+    m_loadTimer = new QTimer(this);
+    m_loadTimer->setSingleShot(true);
+    m_loadTimer->setInterval(0);
+    connect(m_loadTimer, &QTimer::timeout,
+            this, &VMdEdit::loadNextChunks);
+
+    m_pasteTimer = new QTimer(this);
+    m_pasteTimer->setSingleShot(true);
+    m_pasteTimer->setInterval(0);
+    connect(m_pasteTimer, &QTimer::timeout,
+            this, &VMdEdit::pasteNextChunks);
 
     m_editOps->updateTabSettings();
     updateFontAndPalette();
 }
 
+VMdEdit::~VMdEdit()
+{
+    // The document may outlive m_previewBlocks.
+    untrackAllImagePreviewBlocks();
+    // Changes are either saved or discarded when closing normally.
+    m_journal->discard();
+}
+
 void VMdEdit::updateFontAndPalette()
 {
     setFont(vconfig.getMdEditFont());
@@ -53,12 +125,19 @@ void VMdEdit::beginEdit()
     m_editOps->updateTabSettings();
     updateFontAndPalette();
 
+    if (isLoading()) {
+        // Keep read-only until all the content is loaded.
+        m_editAfterLoading = true;
+        return;
+    }
+
     Q_ASSERT(m_file->getContent() == toPlainTextWithoutImg());
 
     initInitImages();
 
     setReadOnly(false);
     setModified(false);
+    startJournal(m_file->getContent().toUtf8());
 
     // Request update outline.
     generateEditOutline();
@@ -66,6 +145,8 @@ void VMdEdit::beginEdit()
 
 void VMdEdit::endEdit()
 {
+    m_editAfterLoading = false;
+    discardJournal();
     setReadOnly(true);
     clearUnusedImages();
 }
@@ -75,16 +156,153 @@ void VMdEdit::saveFile()
     if (!document()->isModified()) {
         return;
     }
-    m_file->setContent(toPlainTextWithoutImg());
+    QByteArray data = toUtf8WithoutImg();
+    m_file->setUtf8Content(data);
     document()->setModified(false);
+    startJournal(data);
+}
+
+void VMdEdit::startJournal(const QByteArray &p_utf8Content)
+{
+    // The journal is based on the saved content with the image preview
+    // blocks inserted.
+    QVector<QPair<int, QString> > previewBlocks;
+    previewBlocks.reserve(m_previewBlocks.size());
+    for (auto data : m_previewBlocks) {
+        QTextBlock block = data->block();
+        previewBlocks.append(QPair<int, QString>(block.blockNumber(), block.text()));
+    }
+    // Replay inserts them in order.
+    std::sort(previewBlocks.begin(), previewBlocks.end());
+    m_discardJournalAfterSave = false;
+    m_journal->start(m_file->retrivePath(), VEditJournal::contentHash(p_utf8Content),
+                     previewBlocks);
+}
+
+void VMdEdit::discardJournal()
+{
+    if (m_file->isSaving()) {
+        // The journal is still needed if the save fails.
+        m_journal->stop();
+        m_discardJournalAfterSave = true;
+        return;
+    }
+    m_journal->discard();
+}
+
+void VMdEdit::handleSaveFinished(bool p_succeeded)
+{
+    if (p_succeeded) {
+        m_journal->dropPrevious();
+        if (m_discardJournalAfterSave) {
+            m_journal->discard();
+        }
+    }
+    m_discardJournalAfterSave = false;
 }
 
 void VMdEdit::reloadFile()
 {
     const QString &content = m_file->getContent();
     Q_ASSERT(content.indexOf(QChar::ObjectReplacementCharacter) == -1);
-    setPlainText(content);
+    discardJournal();
+    untrackAllImagePreviewBlocks();
+    if (isLoading()) {
+        // Abort previous loading.
+        m_loadTimer->stop();
+        m_pendingContent = QString();
+        document()->setUndoRedoEnabled(true);
+        m_loadingProgress = 100;
+        emit loadingProgressChanged(m_loadingProgress);
+    }
+
+    if (content.size() <= c_progressiveLoadSize) {
+        setPlainText(content);
+        setModified(false);
+        // No-op if the highlighter is not suspended by previous loading.
+        m_mdHighlighter->resume();
+        if (m_editAfterLoading) {
+            m_editAfterLoading = false;
+            beginEdit();
+        }
+        return;
+    }
+
+    // Show the first chunk right now and append the rest in time slices.
+    // Highlight, outline and undo are suspended until it is done.
+    qDebug() << "load" << content.size() << "characters progressively";
+    m_mdHighlighter->suspend();
+    document()->setUndoRedoEnabled(false);
+    m_pendingContent = content;
+    m_loadedSize = 0;
+    m_loadingProgress = 0;
+    setReadOnly(true);
+    setPlainText(QString());
+    appendPendingContent(0);
     setModified(false);
+    emit loadingProgressChanged(m_loadingProgress);
+    m_loadTimer->start();
+}
+
+void VMdEdit::appendPendingContent(qint64 p_deadline)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    int total = m_pendingContent.size();
+    do {
+        // Cut at a new line so that a block is not split across chunks.
+        int end = m_loadedSize + c_loadChunkSize;
+        if (end >= total) {
+            end = total;
+        } else {
+            int idx = m_pendingContent.indexOf('\n', end);
+            end = idx == -1 ? total : idx + 1;
+        }
+        cursor.insertText(m_pendingContent.mid(m_loadedSize, end - m_loadedSize));
+        m_loadedSize = end;
+    } while (m_loadedSize < total && (p_deadline < 0 || elapsed.elapsed() < p_deadline));
+}
+
+void VMdEdit::loadNextChunks()
+{
+    appendPendingContent(c_loadTimeSlice);
+    setModified(false);
+    if (m_loadedSize < m_pendingContent.size()) {
+        int progress = (qint64)m_loadedSize * 100 / m_pendingContent.size();
+        if (progress != m_loadingProgress) {
+            m_loadingProgress = progress;
+            emit loadingProgressChanged(m_loadingProgress);
+        }
+        m_loadTimer->start();
+    } else {
+        finishLoading();
+    }
+}
+
+void VMdEdit::finishLoading()
+{
+    if (!isLoading()) {
+        return;
+    }
+    m_loadTimer->stop();
+    if (m_loadedSize < m_pendingContent.size()) {
+        appendPendingContent(-1);
+    }
+    qDebug() << "loading finished" << m_pendingContent.size();
+    m_pendingContent = QString();
+    m_loadedSize = 0;
+    document()->setUndoRedoEnabled(true);
+    setModified(false);
+    m_mdHighlighter->resume();
+    m_loadingProgress = 100;
+    emit loadingProgressChanged(m_loadingProgress);
+
+    if (m_editAfterLoading) {
+        m_editAfterLoading = false;
+        beginEdit();
+    }
 }
 
 void VMdEdit::keyPressEvent(QKeyEvent *event)
@@ -160,9 +378,121 @@ void VMdEdit::insertFromMimeData(const QMimeData *source)
         }
         Q_ASSERT(source->hasText());
     }
+    if (source->hasText()) {
+        QString text = source->text();
+        if (text.size() > c_chunkedPasteSize) {
+            pasteInChunks(text.replace("\r\n", "\n"));
+            return;
+        }
+    }
     VEdit::insertFromMimeData(source);
 }
 
+void VMdEdit::pasteInChunks(const QString &p_text)
+{
+    qDebug() << "paste" << p_text.size() << "characters in chunks";
+    m_pasteText = p_text;
+    m_pastedSize = 0;
+    m_mdHighlighter->suspend();
+    // Clearing the history would break the joining and undo of the chunks.
+    setUndoCompactionSuspended(true);
+    setReadOnly(true);
+
+    // The first chunk is inserted within a new edit block, which the
+    // following chunks join.
+    QTextCursor cursor = textCursor();
+    cursor.beginEditBlock();
+    cursor.removeSelectedText();
+    insertPasteChunks(cursor);
+    cursor.endEditBlock();
+
+    if (m_pastedSize < m_pasteText.size()) {
+        m_pasteProgress = new QProgressDialog(tr("Pasting text..."), tr("Cancel"),
+                                              0, 100, this);
+        m_pasteProgress->setWindowModality(Qt::WindowModal);
+        m_pasteProgress->setMinimumDuration(0);
+        connect(m_pasteProgress, &QProgressDialog::canceled,
+                this, &VMdEdit::cancelPaste);
+        m_pasteProgress->setValue((qint64)m_pastedSize * 100 / m_pasteText.size());
+        m_pasteTimer->start();
+    } else {
+        finishPaste();
+    }
+}
+
+void VMdEdit::insertPasteChunks(QTextCursor &p_cursor)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+    int total = m_pasteText.size();
+    do {
+        // Cut at a new line like appendPendingContent().
+        int end = m_pastedSize + c_loadChunkSize;
+        if (end >= total) {
+            end = total;
+        } else {
+            int idx = m_pasteText.indexOf('\n', end);
+            end = idx == -1 ? total : idx + 1;
+        }
+        p_cursor.insertText(m_pasteText.mid(m_pastedSize, end - m_pastedSize));
+        m_pastedSize = end;
+    } while (m_pastedSize < total && elapsed.elapsed() < c_loadTimeSlice);
+    m_pastePos = p_cursor.position();
+}
+
+void VMdEdit::pasteNextChunks()
+{
+    if (m_pasteText.isNull()) {
+        return;
+    }
+    QTextCursor cursor(document());
+    cursor.setPosition(m_pastePos);
+    cursor.joinPreviousEditBlock();
+    insertPasteChunks(cursor);
+    cursor.endEditBlock();
+
+    if (m_pastedSize < m_pasteText.size()) {
+        m_pasteProgress->setValue((qint64)m_pastedSize * 100 / m_pasteText.size());
+        m_pasteTimer->start();
+    } else {
+        finishPaste();
+    }
+}
+
+void VMdEdit::cancelPaste()
+{
+    if (m_pasteText.isNull()) {
+        return;
+    }
+    qDebug() << "paste canceled" << m_pastedSize << m_pasteText.size();
+    m_pasteTimer->stop();
+    m_pasteText = QString();
+    // Revert the whole paste, which is one undo step.
+    document()->undo();
+    m_pastePos = textCursor().position();
+    finishPaste();
+}
+
+void VMdEdit::finishPaste()
+{
+    m_pasteTimer->stop();
+    m_pasteText = QString();
+    m_pastedSize = 0;
+    if (m_pasteProgress) {
+        m_pasteProgress->disconnect(this);
+        m_pasteProgress->deleteLater();
+        m_pasteProgress = NULL;
+    }
+    setReadOnly(false);
+
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(m_pastePos);
+    setTextCursor(cursor);
+    // Parse and update the outline once for the whole paste.
+    m_mdHighlighter->resume();
+    setUndoCompactionSuspended(false);
+}
+
 void VMdEdit::imageInserted(const QString &p_name)
 {
     m_insertedImages.append(p_name);
@@ -225,7 +555,7 @@ void VMdEdit::updateCurHeader()
 {
     int curHeader = 0;
     QTextCursor cursor(this->textCursor());
-    int curLine = cursor.block().firstLineNumber();
+    int curLine = cursor.block().blockNumber();
     int i = 0;
     for (i = m_headers.size() - 1; i >= 0; --i) {
         if (m_headers[i].lineNumber <= curLine) {
@@ -240,21 +570,20 @@ void VMdEdit::generateEditOutline()
 {
     QTextDocument *doc = document();
     m_headers.clear();
-    // Assume that each block contains only one line
+    // Use block numbers as line numbers, which do not depend on the layout.
     // Only support # syntax for now
     QRegExp headerReg("(#{1,6})\\s*(\\S.*)");  // Need to trim the spaces
     int lastLevel = 0;
     for (QTextBlock block = doc->begin(); block != doc->end(); block = block.next()) {
-        Q_ASSERT(block.lineCount() == 1);
         if ((block.userState() == HighlightBlockState::Normal) &&
             headerReg.exactMatch(block.text())) {
             int level = headerReg.cap(1).length();
             VHeader header(level, headerReg.cap(2).trimmed(),
-                           "", block.firstLineNumber());
+                           "", block.blockNumber());
             while (level > lastLevel + 1) {
                 // Insert empty level.
                 m_headers.append(VHeader(++lastLevel, "[EMPTY]",
-                                         "", block.firstLineNumber()));
+                                         "", block.blockNumber()));
             }
             m_headers.append(header);
             lastLevel = level;
@@ -265,6 +594,217 @@ void VMdEdit::generateEditOutline()
     updateCurHeader();
 }
 
+QTextBlock VMdEdit::foldRegionEnd(const QTextBlock &p_block) const
+{
+    QTextDocument *doc = document();
+    if (p_block.userState() == HighlightBlockState::CodeBlock
+        && p_block.previous().userState() != HighlightBlockState::CodeBlock) {
+        // Fenced code block till the closing fence.
+        QTextBlock block = p_block.next();
+        while (block.isValid() && block.userState() == HighlightBlockState::CodeBlock) {
+            block = block.next();
+        }
+        return block.isValid() ? block : doc->lastBlock();
+    }
+
+    if (!p_block.text().startsWith('#')) {
+        return QTextBlock();
+    }
+    // Section till the next header of the same or higher level.
+    int line = p_block.blockNumber();
+    int idx = -1;
+    for (int i = 0; i < m_headers.size(); ++i) {
+        if (m_headers[i].lineNumber == line) {
+            // Skip the inserted empty levels.
+            idx = i;
+        } else if (idx > -1) {
+            if (m_headers[i].level <= m_headers[idx].level) {
+                return doc->findBlockByNumber(m_headers[i].lineNumber - 1);
+            }
+        }
+    }
+    return idx > -1 ? doc->lastBlock() : QTextBlock();
+}
+
+bool VMdEdit::isFolded(const QTextBlock &p_block) const
+{
+    QTextBlock next = p_block.next();
+    return p_block.isVisible() && next.isValid() && !next.isVisible();
+}
+
+void VMdEdit::setRegionVisible(const QTextBlock &p_block, const QTextBlock &p_last,
+                               bool p_visible)
+{
+    if (!p_last.isValid() || p_last.blockNumber() <= p_block.blockNumber()) {
+        return;
+    }
+    QTextBlock block = p_block.next();
+    int start = block.position();
+    while (block.isValid()) {
+        block.setVisible(p_visible);
+        if (block == p_last) {
+            break;
+        }
+        block = block.next();
+    }
+    // Re-layout the blocks. Invisible blocks take no space.
+    document()->markContentsDirty(start, p_last.position() + p_last.length() - start);
+    viewport()->update();
+}
+
+void VMdEdit::toggleFold()
+{
+    QTextCursor cursor = textCursor();
+    QTextBlock block = cursor.block();
+    if (isFolded(block)) {
+        // Unfold all the blocks hidden after it, including nested regions.
+        QTextBlock last = block.next();
+        while (last.next().isValid() && !last.next().isVisible()) {
+            last = last.next();
+        }
+        setRegionVisible(block, last, true);
+        return;
+    }
+
+    QTextBlock last = foldRegionEnd(block);
+    if (!last.isValid()) {
+        // Fold the section containing the cursor.
+        int line = block.blockNumber();
+        for (int i = m_headers.size() - 1; i >= 0; --i) {
+            if (m_headers[i].lineNumber < line) {
+                block = document()->findBlockByNumber(m_headers[i].lineNumber);
+                last = foldRegionEnd(block);
+                break;
+            }
+        }
+        if (!last.isValid()) {
+            return;
+        }
+        cursor.setPosition(block.position());
+        setTextCursor(cursor);
+    }
+    setRegionVisible(block, last, false);
+}
+
+void VMdEdit::foldOtherSections()
+{
+    QTextDocument *doc = document();
+    int nrHeaders = m_headers.size();
+    if (nrHeaders == 0) {
+        return;
+    }
+    // Last line of each section, till the next header of the same or higher
+    // level, in one pass.
+    QVector<int> lastLines(nrHeaders, doc->blockCount() - 1);
+    QVector<int> openHeaders;
+    for (int i = 0; i < nrHeaders; ++i) {
+        while (!openHeaders.isEmpty()
+               && m_headers[openHeaders.last()].level >= m_headers[i].level) {
+            lastLines[openHeaders.last()] = m_headers[i].lineNumber - 1;
+            openHeaders.removeLast();
+        }
+        openHeaders.append(i);
+    }
+
+    int line = textCursor().block().blockNumber();
+    int foldedLine = -1;
+    int dirtyStart = -1;
+    int dirtyEnd = -1;
+    for (int i = 0; i < nrHeaders; ++i) {
+        int headerLine = m_headers[i].lineNumber;
+        // The inserted empty levels share the line of the real header, whose
+        // section is folded. Skip the headers within folded regions.
+        if ((i + 1 < nrHeaders && m_headers[i + 1].lineNumber == headerLine)
+            || headerLine <= foldedLine) {
+            continue;
+        }
+        int lastLine = lastLines[i];
+        if (lastLine <= headerLine || (line >= headerLine && line <= lastLine)) {
+            continue;
+        }
+        QTextBlock block = doc->findBlockByNumber(headerLine);
+        if (!block.isVisible()) {
+            continue;
+        }
+        block = block.next();
+        if (dirtyStart == -1) {
+            dirtyStart = block.position();
+        }
+        for (int nr = headerLine + 1; nr <= lastLine && block.isValid(); ++nr) {
+            block.setVisible(false);
+            dirtyEnd = block.position() + block.length();
+            block = block.next();
+        }
+        foldedLine = lastLine;
+    }
+
+    if (dirtyStart != -1) {
+        // Re-layout the blocks once. Invisible blocks take no space.
+        doc->markContentsDirty(dirtyStart, dirtyEnd - dirtyStart);
+        viewport()->update();
+    }
+}
+
+void VMdEdit::unfoldAll()
+{
+    QTextDocument *doc = document();
+    bool changed = false;
+    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
+        if (!block.isVisible()) {
+            block.setVisible(true);
+            changed = true;
+        }
+    }
+    if (changed) {
+        doc->markContentsDirty(0, doc->characterCount());
+        viewport()->update();
+    }
+}
+
+void VMdEdit::unfoldCursorBlock()
+{
+    QTextBlock block = textCursor().block();
+    if (block.isVisible()) {
+        return;
+    }
+    // Unfold the whole hidden region around the cursor.
+    QTextBlock first = block;
+    while (first.previous().isValid() && !first.previous().isVisible()) {
+        first = first.previous();
+    }
+    QTextBlock last = block;
+    while (last.next().isValid() && !last.next().isVisible()) {
+        last = last.next();
+    }
+    if (first.previous().isValid()) {
+        setRegionVisible(first.previous(), last, true);
+    } else {
+        unfoldAll();
+    }
+}
+
+void VMdEdit::paintEvent(QPaintEvent *p_event)
+{
+    VEdit::paintEvent(p_event);
+
+    // Draw an ellipsis after the line starting a folded region.
+    QRect rect = viewport()->rect();
+    QTextBlock block = cursorForPosition(rect.topLeft()).block();
+    int lastBlock = cursorForPosition(rect.bottomRight()).blockNumber();
+    QPainter painter(viewport());
+    painter.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+    for (; block.isValid() && block.blockNumber() <= lastBlock; block = block.next()) {
+        if (!isFolded(block)) {
+            continue;
+        }
+        QTextCursor cursor(block);
+        cursor.movePosition(QTextCursor::EndOfBlock);
+        QRect endRect = cursorRect(cursor);
+        painter.drawText(endRect.right() + fontMetrics().width(' '),
+                         endRect.top() + fontMetrics().ascent(), "...");
+    }
+}
+
 void VMdEdit::scrollToHeader(int p_headerIndex)
 {
     Q_ASSERT(p_headerIndex >= 0);
@@ -281,7 +821,8 @@ void VMdEdit::updateImageBlocks(QSet<int> p_imageBlocks)
         return;
     }
     // We need to handle blocks backward to avoid shifting all the following blocks.
-    // Inserting the preview image block may cause highlighter to emit signal again.
+    // The highlighter will not re-parse for these changes.
+    m_mdHighlighter->beginInternalChange();
     QList<int> blockList = p_imageBlocks.toList();
     std::sort(blockList.begin(), blockList.end(), std::greater<int>());
     auto it = blockList.begin();
@@ -292,27 +833,103 @@ void VMdEdit::updateImageBlocks(QSet<int> p_imageBlocks)
 
     // Clean up un-referenced QChar::ObjectReplacementCharacter.
     clearOrphanImagePreviewBlock();
+    m_mdHighlighter->endInternalChange();
 
     emit statusChanged();
 }
 
+void VMdEdit::handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    if (p_charsRemoved == 0 && p_charsAdded == 0) {
+        return;
+    }
+    if (m_journal->isActive()) {
+        QString added;
+        if (p_charsAdded > 0) {
+            QTextCursor cursor(document());
+            int last = document()->characterCount() - 1;
+            cursor.setPosition(qMin(p_position, last));
+            cursor.setPosition(qMin(p_position + p_charsAdded, last), QTextCursor::KeepAnchor);
+            added = cursor.selectedText();
+            added.replace(QChar::ParagraphSeparator, '\n');
+        }
+        m_journal->recordChange(p_position, p_charsRemoved, added);
+    }
+    int end = p_position + p_charsAdded;
+    if (m_dirtyStart == -1) {
+        m_dirtyStart = p_position;
+        m_dirtyEnd = end;
+        return;
+    }
+    // Shift or clamp the end of the recorded region.
+    if (m_dirtyEnd >= p_position + p_charsRemoved) {
+        m_dirtyEnd += p_charsAdded - p_charsRemoved;
+    } else if (m_dirtyEnd > p_position) {
+        m_dirtyEnd = end;
+    }
+    m_dirtyStart = qMin(m_dirtyStart, p_position);
+    m_dirtyEnd = qMax(m_dirtyEnd, end);
+}
+
 void VMdEdit::clearOrphanImagePreviewBlock()
 {
+    if (m_dirtyStart == -1) {
+        return;
+    }
     QTextDocument *doc = document();
-    QTextBlock block = doc->begin();
+    QTextBlock block = doc->findBlock(m_dirtyStart);
+    QTextBlock endBlock = doc->findBlock(m_dirtyEnd);
+    // Removing or inserting blocks below will record a new region.
+    m_dirtyStart = m_dirtyEnd = -1;
+    if (!block.isValid()) {
+        return;
+    }
+    // An image preview block depends on its previous block, so we need to
+    // check the block after the changed region too.
+    if (!endBlock.isValid()) {
+        endBlock = doc->lastBlock();
+    } else if (endBlock.next().isValid()) {
+        endBlock = endBlock.next();
+    }
     while (block.isValid()) {
+        bool lastBlock = block == endBlock;
+        QTextBlock nextBlock = block.next();
         if (isOrphanImagePreviewBlock(block)) {
             qDebug() << "remove orphan image preview block" << block.blockNumber();
-            QTextBlock nextBlock = block.next();
             removeBlock(block);
-            block = nextBlock;
         } else {
             clearCorruptedImagePreviewBlock(block);
-            block = block.next();
+            updateImagePreviewBlockTracking(block);
+        }
+        if (lastBlock) {
+            break;
         }
+        block = nextBlock;
     }
 }
 
+void VMdEdit::updateImagePreviewBlockTracking(QTextBlock p_block)
+{
+    VImagePreviewBlockData *data = dynamic_cast<VImagePreviewBlockData *>(p_block.userData());
+    if (isImagePreviewBlock(p_block)) {
+        if (!data) {
+            // Such as a preview block restored by undo.
+            p_block.setUserData(new VImagePreviewBlockData(p_block, &m_previewBlocks));
+        }
+    } else if (data) {
+        // Will delete the data and untrack it.
+        p_block.setUserData(NULL);
+    }
+}
+
+void VMdEdit::untrackAllImagePreviewBlocks()
+{
+    for (auto data : m_previewBlocks) {
+        data->detach();
+    }
+    m_previewBlocks.clear();
+}
+
 bool VMdEdit::isOrphanImagePreviewBlock(QTextBlock p_block)
 {
     if (isImagePreviewBlock(p_block)) {
@@ -377,19 +994,18 @@ void VMdEdit::clearCorruptedImagePreviewBlock(QTextBlock p_block)
 
 void VMdEdit::clearAllImagePreviewBlocks()
 {
-    QTextDocument *doc = document();
-    QTextBlock block = doc->begin();
     bool modified = isModified();
-    while (block.isValid()) {
-        if (isImagePreviewBlock(block)) {
-            QTextBlock nextBlock = block.next();
-            removeBlock(block);
-            block = nextBlock;
-        } else {
-            clearCorruptedImagePreviewBlock(block);
-            block = block.next();
-        }
+    // Removing a block will delete its data, so collect the blocks first.
+    QVector<QTextBlock> blocks;
+    blocks.reserve(m_previewBlocks.size());
+    for (auto data : m_previewBlocks) {
+        blocks.append(data->block());
     }
+    m_mdHighlighter->beginInternalChange();
+    for (int i = 0; i < blocks.size(); ++i) {
+        removeBlock(blocks[i]);
+    }
+    m_mdHighlighter->endInternalChange();
     setModified(modified);
     emit statusChanged();
 }
@@ -433,22 +1049,33 @@ void VMdEdit::previewImageOfBlock(int p_block)
 
 bool VMdEdit::isImagePreviewBlock(int p_block)
 {
-    QTextDocument *doc = document();
-    QTextBlock block = doc->findBlockByNumber(p_block);
-    if (!block.isValid()) {
-        return false;
-    }
-    QString text = block.text().trimmed();
-    return text == QString(QChar::ObjectReplacementCharacter);
+    return isImagePreviewBlock(document()->findBlockByNumber(p_block));
 }
 
-bool VMdEdit::isImagePreviewBlock(QTextBlock p_block)
+bool VMdEdit::isImagePreviewBlock(QTextBlock p_block) const
 {
     if (!p_block.isValid()) {
         return false;
     }
-    QString text = p_block.text().trimmed();
-    return text == QString(QChar::ObjectReplacementCharacter);
+    return isImagePreviewText(p_block.text());
+}
+
+bool VMdEdit::isImagePreviewText(const QString &p_text)
+{
+    // Scan the text instead of making a trimmed copy of it.
+    bool found = false;
+    for (int i = 0; i < p_text.size(); ++i) {
+        const QChar &ch = p_text.at(i);
+        if (ch == QChar::ObjectReplacementCharacter) {
+            if (found) {
+                return false;
+            }
+            found = true;
+        } else if (!ch.isSpace()) {
+            return false;
+        }
+    }
+    return found;
 }
 
 void VMdEdit::insertImagePreviewBlock(int p_block, const QString &p_image)
@@ -475,6 +1102,8 @@ void VMdEdit::insertImagePreviewBlock(int p_block, const QString &p_image)
     cursor.insertImage(imgFormat);
     Q_ASSERT(cursor.block().text().at(0) == QChar::ObjectReplacementCharacter);
     cursor.endEditBlock();
+    QTextBlock block = cursor.block();
+    block.setUserData(new VImagePreviewBlockData(block, &m_previewBlocks));
 
     QTextCursor tmp = textCursor();
     tmp.setPosition(pos);
@@ -524,28 +1153,48 @@ void VMdEdit::removeBlock(QTextBlock p_block)
 
 QString VMdEdit::toPlainTextWithoutImg() const
 {
-    QString text = toPlainText();
-    int start = 0;
-    do {
-        int index = text.indexOf(QChar::ObjectReplacementCharacter, start);
-        if (index == -1) {
-            break;
+    QString text;
+    QTextDocument *doc = document();
+    text.reserve(doc->characterCount());
+    bool firstBlock = true;
+    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
+        if (isImagePreviewBlock(block)) {
+            continue;
+        }
+        if (firstBlock) {
+            firstBlock = false;
+        } else {
+            text.append('\n');
         }
-        start = removeObjectReplacementLine(text, index);
-    } while (start > -1 && start < text.size());
+        text.append(block.text());
+    }
+    text.remove(QChar::ObjectReplacementCharacter);
     return text;
 }
 
-int VMdEdit::removeObjectReplacementLine(QString &p_text, int p_index) const
+QByteArray VMdEdit::toUtf8WithoutImg() const
 {
-    Q_ASSERT(p_text.size() > p_index && p_text.at(p_index) == QChar::ObjectReplacementCharacter);
-    int prevLineIdx = p_text.lastIndexOf('\n', p_index);
-    if (prevLineIdx == -1) {
-        prevLineIdx = 0;
+    QByteArray data;
+    QTextDocument *doc = document();
+    data.reserve(doc->characterCount());
+    bool firstBlock = true;
+    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
+        if (isImagePreviewBlock(block)) {
+            continue;
+        }
+        if (firstBlock) {
+            firstBlock = false;
+        } else {
+            data.append('\n');
+        }
+        QString text = block.text();
+        if (text.contains(QChar::ObjectReplacementCharacter)) {
+            // Corrupted image preview block.
+            text.remove(QChar::ObjectReplacementCharacter);
+        }
+        VUtils::appendUtf8(data, text);
     }
-    // Remove [\n....?]
-    p_text.remove(prevLineIdx, p_index - prevLineIdx + 1);
-    return prevLineIdx - 1;
+    return data;
 }
 
 void VMdEdit::handleEditStateChanged(KeyState p_state)
@@ -6,16 +6,53 @@
 #include <QString>
 #include <QColor>
 #include <QClipboard>
+#include <QSet>
+#include <QTextBlock>
+#include <QTextBlockUserData>
 #include "vtoc.h"
 #include "veditoperations.h"
+#include "vtextsnapshot.h"
 
 class HGMarkdownHighlighter;
+class VEditJournal;
+class VDocStatistics;
+class QProgressDialog;
+class VImagePreviewBlockData;
+
+typedef QSet<VImagePreviewBlockData *> VImagePreviewBlockSet;
+
+// User data attached to an image preview block to track it. It will be removed
+// from the set once QTextDocument deletes the block.
+class VImagePreviewBlockData : public QTextBlockUserData
+{
+public:
+    VImagePreviewBlockData(const QTextBlock &p_block, VImagePreviewBlockSet *p_set);
+    ~VImagePreviewBlockData();
+    inline QTextBlock block() const;
+    // Stop tracking, for example, when the set is destroyed.
+    inline void detach();
+
+private:
+    QTextBlock m_block;
+    VImagePreviewBlockSet *m_set;
+};
+
+inline QTextBlock VImagePreviewBlockData::block() const
+{
+    return m_block;
+}
+
+inline void VImagePreviewBlockData::detach()
+{
+    m_set = NULL;
+}
 
 class VMdEdit : public VEdit
 {
     Q_OBJECT
 public:
     VMdEdit(VFile *p_file, QWidget *p_parent = 0);
+    ~VMdEdit();
     void beginEdit() Q_DECL_OVERRIDE;
     void endEdit() Q_DECL_OVERRIDE;
     void saveFile() Q_DECL_OVERRIDE;
@@ -28,11 +65,32 @@ public:
     void scrollToHeader(int p_headerIndex);
     // Like toPlainText(), but remove special blocks containing images.
     QString toPlainTextWithoutImg() const;
+    // Like toPlainTextWithoutImg(), but encode the text in UTF-8 directly
+    // in one pass over the blocks.
+    QByteArray toUtf8WithoutImg() const;
+    // Whether the content of the file is still being appended to the document.
+    inline bool isLoading() const;
+    // Whether @p_text is the text of an image preview block.
+    static bool isImagePreviewText(const QString &p_text);
+    inline const VDocStatistics *getStatistics() const;
+    // O(1) copy of current text for background workers. Image preview blocks
+    // are included as they are in the document.
+    inline VTextSnapshot getSnapshot() const;
+    // Fold or unfold the section or fenced code block starting at the cursor,
+    // or fold the section containing the cursor.
+    void toggleFold();
+    // Fold all the sections except the ones containing the cursor.
+    void foldOtherSections();
+    void unfoldAll();
 
 signals:
     void headersChanged(const QVector<VHeader> &headers);
     void curHeaderChanged(int p_lineNumber, int p_outlineIndex);
     void statusChanged();
+    // Emitted during loading a large file. 100 means loading is finished.
+    void loadingProgressChanged(int p_percent);
+    // Emitted when the counts of the document or the selection change.
+    void statisticsChanged();
 
 private slots:
     void generateEditOutline();
@@ -42,28 +100,43 @@ private slots:
     void handleEditStateChanged(KeyState p_state);
     void handleSelectionChanged();
     void handleClipboardChanged(QClipboard::Mode p_mode);
+    // Record the changed region for clearOrphanImagePreviewBlock().
+    void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+    // Append chunks of the content for a while.
+    void loadNextChunks();
+    void handleSaveFinished(bool p_succeeded);
+    // Unfold the region if the cursor moves into it.
+    void unfoldCursorBlock();
+    // Insert the pasted text for a time slice.
+    void pasteNextChunks();
+    // Cancel the paste in progress and restore the document.
+    void cancelPaste();
 
 protected:
     void keyPressEvent(QKeyEvent *event) Q_DECL_OVERRIDE;
     bool canInsertFromMimeData(const QMimeData *source) const Q_DECL_OVERRIDE;
     void insertFromMimeData(const QMimeData *source) Q_DECL_OVERRIDE;
     void updateFontAndPalette() Q_DECL_OVERRIDE;
+    // Mark the folded regions.
+    void paintEvent(QPaintEvent *p_event) Q_DECL_OVERRIDE;
 
 private:
     void initInitImages();
     void clearUnusedImages();
-    // p_text[p_index] is QChar::ObjectReplacementCharacter. Remove the line containing it.
-    // Returns the index of previous line's '\n'.
-    int removeObjectReplacementLine(QString &p_text, int p_index) const;
     void previewImageOfBlock(int p_block);
     bool isImagePreviewBlock(int p_block);
-    bool isImagePreviewBlock(QTextBlock p_block);
+    bool isImagePreviewBlock(QTextBlock p_block) const;
     // p_block is a image preview block. We need to update it with image.
     void updateImagePreviewBlock(int p_block, const QString &p_image);
     // Insert a block after @p_block to preview image @p_image.
     void insertImagePreviewBlock(int p_block, const QString &p_image);
-    // Clean up un-referenced image preview block.
+    // Clean up un-referenced and corrupted image preview blocks within
+    // the region changed since last call.
     void clearOrphanImagePreviewBlock();
+    // Track or untrack @p_block in m_previewBlocks according to its content.
+    void updateImagePreviewBlockTracking(QTextBlock p_block);
+    // Stop tracking all the image preview blocks without touching the document.
+    void untrackAllImagePreviewBlocks();
     void removeBlock(QTextBlock p_block);
     bool isOrphanImagePreviewBlock(QTextBlock p_block);
     // Block that has the QChar::ObjectReplacementCharacter as well as some non-space characters.
@@ -74,12 +147,75 @@ private:
     void clearAllImagePreviewBlocks();
     // There is a QChar::ObjectReplacementCharacter in the selection. Find out the image path.
     QString selectedImage();
+    // Append the content to the document until @p_deadline (in ms) passes.
+    // -1 to append all of it.
+    void appendPendingContent(qint64 p_deadline);
+    void finishLoading();
+    // Start a new journal based on the saved content @p_utf8Content.
+    void startJournal(const QByteArray &p_utf8Content);
+    // Delete the journal, or after the pending save succeeds.
+    void discardJournal();
+    // Paste large @p_text in time slices within one undo step. Highlight and
+    // outline are suspended until it is done.
+    void pasteInChunks(const QString &p_text);
+    // Insert chunks of m_pasteText at @p_cursor for a time slice.
+    void insertPasteChunks(QTextCursor &p_cursor);
+    void finishPaste();
+    // Returns the last block of the section or fenced code block starting
+    // at @p_block, or an invalid block if @p_block starts none.
+    QTextBlock foldRegionEnd(const QTextBlock &p_block) const;
+    // Whether the region starting at @p_block is folded.
+    bool isFolded(const QTextBlock &p_block) const;
+    // Show or hide the blocks after @p_block till @p_last.
+    void setRegionVisible(const QTextBlock &p_block, const QTextBlock &p_last,
+                          bool p_visible);
 
     HGMarkdownHighlighter *m_mdHighlighter;
     QVector<QString> m_insertedImages;
     QVector<QString> m_initImages;
     QVector<VHeader> m_headers;
     bool m_previewImage;
+    // All the image preview blocks in the document.
+    VImagePreviewBlockSet m_previewBlocks;
+    // Region [m_dirtyStart, m_dirtyEnd] changed since last clean up.
+    // -1 if nothing changed.
+    int m_dirtyStart;
+    int m_dirtyEnd;
+    // Content of a large file not appended to the document yet.
+    QString m_pendingContent;
+    int m_loadedSize;
+    int m_loadingProgress;
+    QTimer *m_loadTimer;
+    // beginEdit() is requested during loading.
+    bool m_editAfterLoading;
+    // Pasted text not inserted yet.
+    QString m_pasteText;
+    int m_pastedSize;
+    // Position to insert the next chunk of m_pasteText.
+    int m_pastePos;
+    QTimer *m_pasteTimer;
+    QProgressDialog *m_pasteProgress;
+    // Record unsaved changes in edit mode.
+    VEditJournal *m_journal;
+    // Whether to delete the journal once the pending save succeeds.
+    bool m_discardJournalAfterSave;
+    VDocStatistics *m_statistics;
+    VTextSnapshotTracker *m_snapshotTracker;
 };
 
+inline bool VMdEdit::isLoading() const
+{
+    return !m_pendingContent.isNull();
+}
+
+inline const VDocStatistics *VMdEdit::getStatistics() const
+{
+    return m_statistics;
+}
+
+inline VTextSnapshot VMdEdit::getSnapshot() const
+{
+    return m_snapshotTracker->snapshot();
+}
+
 #endif // VMDEDIT_H
@@ -793,9 +793,10 @@ bool VMdEditOperations::handleKeyPressVim(QKeyEvent *p_event)
                 clipboard->setText(cursor.selectedText());
                 cursor.removeSelectedText();
             } else {
-                for (int i = 0; i < repeat; ++i) {
-                    cursor.deleteChar();
-                }
+                // Remove all the characters at once.
+                cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor,
+                                    repeat);
+                cursor.removeSelectedText();
             }
             cursor.endEditBlock();
             m_editor->setTextCursor(cursor);
@@ -1005,22 +1006,41 @@ bool VMdEditOperations::handleKeyPressVim(QKeyEvent *p_event)
     case Qt::Key_D:
     {
         if (modifiers == Qt::NoModifier) {
-            // d, pending or delete current line.
+            // d, pending or delete <repeat> lines.
             QTextCursor cursor = m_editor->textCursor();
-            if (m_pendingKey.isEmpty()) {
-                if (cursor.hasSelection()) {
-                    cursor.deleteChar();
-                    m_editor->setTextCursor(cursor);
+            if (!m_pendingKey.isEmpty() && m_pendingKey.last() == "d") {
+                int repeat = keySeqToNumber(m_pendingKey.mid(0, m_pendingKey.size() - 1));
+                m_pendingKey.clear();
+                if (repeat == 0) {
+                    repeat = 1;
+                }
+                QTextDocument *doc = m_editor->document();
+                QTextBlock firstBlock = cursor.block();
+                QTextBlock lastBlock = doc->findBlockByNumber(firstBlock.blockNumber() + repeat - 1);
+                if (!lastBlock.isValid()) {
+                    lastBlock = doc->lastBlock();
+                }
+                // Remove all the lines at once, with the paragraph separator
+                // before them.
+                cursor.beginEditBlock();
+                if (firstBlock.previous().isValid()) {
+                    cursor.setPosition(firstBlock.position() - 1);
                 } else {
-                    m_pendingKey.append("d");
+                    cursor.setPosition(firstBlock.position());
                 }
-                goto pending;
-            } else if (m_pendingKey.size() == 1 && m_pendingKey.at(0) == "d") {
-                m_pendingKey.clear();
-                cursor.select(QTextCursor::BlockUnderCursor);
+                cursor.setPosition(lastBlock.position() + lastBlock.length() - 1,
+                                   QTextCursor::KeepAnchor);
                 cursor.removeSelectedText();
+                cursor.endEditBlock();
                 m_editor->setTextCursor(cursor);
                 goto pending;
+            } else if (m_pendingKey.isEmpty() && cursor.hasSelection()) {
+                cursor.deleteChar();
+                m_editor->setTextCursor(cursor);
+                goto pending;
+            } else if (m_pendingKey.isEmpty() || keySeqToNumber(m_pendingKey) > 0) {
+                m_pendingKey.append("d");
+                goto pending;
             }
         }
         break;
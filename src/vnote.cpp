@@ -7,11 +7,14 @@
 #include <QFontMetrics>
 #include <QStringList>
 #include <QFontDatabase>
+#include <QThread>
 #include "vnote.h"
 #include "utils/vutils.h"
 #include "vconfigmanager.h"
 #include "vmainwindow.h"
 #include "vorphanfile.h"
+#include "vfilewriter.h"
+#include "vpreviewpool.h"
 
 extern VConfigManager vconfig;
 
@@ -34,10 +37,26 @@ const QString VNote::c_shortcutsDocFile_zh = ":/resources/docs/shortcuts_zh.md";
 VNote::VNote(QObject *parent)
     : QObject(parent), m_mainWindow(dynamic_cast<VMainWindow *>(parent))
 {
+    m_writerThread = new QThread(this);
+    m_fileWriter = new VFileWriter();
+    m_fileWriter->moveToThread(m_writerThread);
+    m_writerThread->start();
+
+    m_previewPool = new VPreviewPool(this);
+
     initTemplate();
     vconfig.getNotebooks(m_notebooks, this);
 }
 
+VNote::~VNote()
+{
+    // Finish all the pending saves before exit.
+    m_fileWriter->waitForFinished();
+    m_writerThread->quit();
+    m_writerThread->wait();
+    delete m_fileWriter;
+}
+
 void VNote::initPalette(QPalette palette)
 {
     m_palette.clear();
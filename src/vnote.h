@@ -15,12 +15,16 @@
 
 class VMainWindow;
 class VFile;
+class VFileWriter;
+class QThread;
+class VPreviewPool;
 
 class VNote : public QObject
 {
     Q_OBJECT
 public:
     VNote(QObject *parent = 0);
+    ~VNote();
 
     const QVector<VNotebook *> &getNotebooks() const;
     QVector<VNotebook *> &getNotebooks();
@@ -58,6 +62,10 @@ public:
     void initPalette(QPalette palette);
     QString getColorFromPalette(const QString &p_name) const;
     inline VMainWindow *getMainWindow() const;
+    // Writer to save notes in a dedicated thread.
+    inline VFileWriter *getFileWriter() const;
+    // Web views shared by the tabs to preview notes.
+    inline VPreviewPool *getPreviewPool() const;
 
     QString getNavigationLabelStyle(const QString &p_str) const;
 
@@ -78,6 +86,10 @@ private:
     // Hold all external file: Orphan File.
     // Need to clean up periodly.
     QList<VFile *> m_externalFiles;
+
+    QThread *m_writerThread;
+    VFileWriter *m_fileWriter;
+    VPreviewPool *m_previewPool;
 };
 
 inline const QVector<QPair<QString, QString> >& VNote::getPalette() const
@@ -90,4 +102,14 @@ inline VMainWindow *VNote::getMainWindow() const
     return m_mainWindow;
 }
 
+inline VFileWriter *VNote::getFileWriter() const
+{
+    return m_fileWriter;
+}
+
+inline VPreviewPool *VNote::getPreviewPool() const
+{
+    return m_previewPool;
+}
+
 #endif // VNOTE_H
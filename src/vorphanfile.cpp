@@ -21,6 +21,7 @@ bool VOrphanFile::open()
     Q_ASSERT(m_docType == (VUtils::isMarkdown(m_name) ? DocType::Markdown : DocType::Html));
     Q_ASSERT(QFileInfo::exists(m_path));
     m_content = VUtils::readFileFromDisk(m_path);
+    m_contentLoaded = true;
     m_modified = false;
     m_opened = true;
     return true;
@@ -87,3 +88,8 @@ void VOrphanFile::setContent(const QString & /* p_content */)
 {
     V_ASSERT(false);
 }
+
+void VOrphanFile::setUtf8Content(const QByteArray & /* p_data */)
+{
+    V_ASSERT(false);
+}
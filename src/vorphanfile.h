@@ -25,6 +25,7 @@ private:
     void setName(const QString &p_name);
     QString retriveImagePath() const;
     void setContent(const QString &p_content);
+    void setUtf8Content(const QByteArray &p_data);
 
     QString m_path;
     friend class VDirectory;
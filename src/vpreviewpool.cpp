@@ -0,0 +1,49 @@
+#include "vpreviewpool.h"
+#include <QWebEngineView>
+#include <QWebChannel>
+#include <QDebug>
+#include "vpreviewpage.h"
+#include "vconfigmanager.h"
+
+extern VConfigManager vconfig;
+
+VPreviewPool::VPreviewPool(QObject *p_parent)
+    : QObject(p_parent)
+{
+}
+
+VPreviewPool::~VPreviewPool()
+{
+    qDeleteAll(m_idleViews);
+    m_idleViews.clear();
+}
+
+QWebEngineView *VPreviewPool::acquire()
+{
+    if (!m_idleViews.isEmpty()) {
+        return m_idleViews.takeLast();
+    }
+
+    qDebug() << "create a new preview view";
+    QWebEngineView *view = new QWebEngineView();
+    VPreviewPage *page = new VPreviewPage(view);
+    view->setPage(page);
+    page->setWebChannel(new QWebChannel(page));
+    return view;
+}
+
+void VPreviewPool::release(QWebEngineView *p_view)
+{
+    Q_ASSERT(p_view);
+    p_view->hide();
+    p_view->setParent(NULL);
+    if (m_idleViews.size() >= vconfig.getPreviewPoolSize()) {
+        qDebug() << "delete preview view" << m_idleViews.size();
+        p_view->deleteLater();
+        return;
+    }
+
+    // Free the content of the page.
+    p_view->setHtml(QString());
+    m_idleViews.append(p_view);
+}
@@ -0,0 +1,32 @@
+#ifndef VPREVIEWPOOL_H
+#define VPREVIEWPOOL_H
+
+#include <QObject>
+#include <QVector>
+
+class QWebEngineView;
+
+// Pool of the web views to preview notes. Tabs take a view when preview is
+// first shown and return it when they are in background for a while, so
+// views are shared instead of one for each tab.
+class VPreviewPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VPreviewPool(QObject *p_parent = 0);
+    ~VPreviewPool();
+
+    // Take an idle view or create a new one. The page of the view has a web
+    // channel without objects registered.
+    QWebEngineView *acquire();
+
+    // Return @p_view, which should have no objects registered in its web
+    // channel. It is kept for reuse if there are fewer idle views than the
+    // limit, or deleted otherwise.
+    void release(QWebEngineView *p_view);
+
+private:
+    QVector<QWebEngineView *> m_idleViews;
+};
+
+#endif // VPREVIEWPOOL_H
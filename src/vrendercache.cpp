@@ -0,0 +1,195 @@
+#include "vrendercache.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QMutex>
+#include <QDebug>
+#if defined(Q_OS_WIN)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+#include "utils/vutils.h"
+
+// "VRDR"
+const quint32 VRenderCache::c_magic = 0x56524452U;
+// Bump it when the rendered HTML changes for the same markdown.
+const quint32 VRenderCache::c_version = 2;
+
+// Hidden folder in the notebook holding the cache.
+static const QString c_cacheFolderName = ".vnote_cache";
+
+// An entry read after this is touched to mark it recently used.
+static const int c_touchInterval = 3600;
+
+// Serialize the eviction of the same folder from several threads.
+static QMutex s_evictMutex;
+
+QString VRenderCache::cacheFolder(const QString &p_notebookPath)
+{
+    return QDir(p_notebookPath).filePath(c_cacheFolderName);
+}
+
+QString VRenderCache::cacheKey(const QString &p_markdown, hoedown_extensions p_options)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(p_markdown.toUtf8());
+    hash.addData(QByteArray::number((int)p_options));
+    // The HTML does not depend on the template, which is applied when shown.
+    hash.addData(QByteArray::number(c_version));
+    return hash.result().toHex();
+}
+
+static void touchFile(const QString &p_filePath)
+{
+#if defined(Q_OS_WIN)
+    _wutime((const wchar_t *)p_filePath.utf16(), NULL);
+#else
+    utime(QFile::encodeName(p_filePath).constData(), NULL);
+#endif
+}
+
+VMarkdownRender VRenderCache::render(const QString &p_notebookPath, const QString &p_markdown,
+                                     hoedown_extensions p_options, int p_cacheSize)
+{
+    VMarkdownRender result;
+    if (VMarkdownConverter::findRender(p_markdown, p_options, result)) {
+        return result;
+    }
+    if (p_cacheSize <= 0 || p_notebookPath.isEmpty()) {
+        return VMarkdownConverter::render(p_markdown, p_options);
+    }
+
+    QString folder = cacheFolder(p_notebookPath);
+    QString filePath = QDir(folder).filePath(cacheKey(p_markdown, p_options));
+    if (load(filePath, result)) {
+        VMarkdownConverter::insertRender(p_markdown, p_options, result);
+        return result;
+    }
+
+    result = VMarkdownConverter::render(p_markdown, p_options);
+    if (QDir().mkpath(folder) && save(filePath, result)) {
+        evict(folder, p_cacheSize);
+    }
+    return result;
+}
+
+bool VRenderCache::load(const QString &p_filePath, VMarkdownRender &p_render)
+{
+    QFile file(p_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version;
+    qint32 nrHeaders;
+    in >> magic >> version;
+    if (magic != c_magic || version != c_version) {
+        return false;
+    }
+    VMarkdownRender render;
+    in >> render.m_html >> nrHeaders;
+    for (int i = 0; i < nrHeaders && in.status() == QDataStream::Ok; ++i) {
+        VHeader header;
+        qint32 level;
+        in >> level >> header.name >> header.anchor;
+        header.level = level;
+        render.m_headers.append(header);
+    }
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "invalid render cache" << p_filePath;
+        return false;
+    }
+    file.close();
+
+    QFileInfo info(p_filePath);
+    if (info.lastModified().secsTo(QDateTime::currentDateTime()) > c_touchInterval) {
+        touchFile(p_filePath);
+    }
+    p_render = render;
+    return true;
+}
+
+bool VRenderCache::save(const QString &p_filePath, const VMarkdownRender &p_render)
+{
+    QSaveFile file(p_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open render cache" << p_filePath;
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << c_magic << c_version << p_render.m_html << (qint32)p_render.m_headers.size();
+    for (int i = 0; i < p_render.m_headers.size(); ++i) {
+        const VHeader &header = p_render.m_headers[i];
+        out << (qint32)header.level << header.name << header.anchor;
+    }
+    return file.commit();
+}
+
+void VRenderCache::evict(const QString &p_folder, int p_cacheSize)
+{
+    QMutexLocker locker(&s_evictMutex);
+    qint64 limit = (qint64)p_cacheSize * 1024 * 1024;
+    QDir dir(p_folder);
+    QFileInfoList entries = dir.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 total = 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        total += entries[i].size();
+    }
+    if (total <= limit) {
+        return;
+    }
+
+    // Evict to 3/4 of the limit so it does not run on every new entry.
+    int nrRemoved = 0;
+    for (int i = 0; i < entries.size() && total > limit / 4 * 3; ++i) {
+        if (dir.remove(entries[i].fileName())) {
+            total -= entries[i].size();
+            ++nrRemoved;
+        }
+    }
+    qDebug() << "evict" << nrRemoved << "render cache entries from" << p_folder;
+}
+
+int VRenderCache::warmNotebook(const QString &p_notebookPath, hoedown_extensions p_options,
+                               int p_cacheSize)
+{
+    if (p_cacheSize <= 0) {
+        return 0;
+    }
+    QString folder = cacheFolder(p_notebookPath);
+    if (!QDir().mkpath(folder)) {
+        return 0;
+    }
+
+    int nrRendered = 0;
+    QDirIterator it(p_notebookPath, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString path = it.next();
+        if (!VUtils::isMarkdown(path) || path.startsWith(folder)) {
+            continue;
+        }
+        QString content = VUtils::readFileFromDisk(path);
+        QString filePath = QDir(folder).filePath(cacheKey(content, p_options));
+        if (QFileInfo::exists(filePath)) {
+            continue;
+        }
+        // Do not flood the memory cache with all the notes.
+        VMarkdownRender result = VMarkdownConverter::generateRender(content, p_options);
+        if (!save(filePath, result)) {
+            break;
+        }
+        ++nrRendered;
+    }
+    if (nrRendered > 0) {
+        evict(folder, p_cacheSize);
+    }
+    qDebug() << "warm render cache of" << p_notebookPath << nrRendered;
+    return nrRendered;
+}
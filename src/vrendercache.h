@@ -0,0 +1,41 @@
+#ifndef VRENDERCACHE_H
+#define VRENDERCACHE_H
+
+#include <QString>
+#include "vmarkdownconverter.h"
+
+// Cache of the Hoedown renderings of notes on disk, in a hidden folder of each
+// notebook. Entries are keyed by the SHA-1 of the content, the extensions and
+// the version of the cache, so they survive restarts and never go stale. The
+// least recently used entries are evicted when the folder exceeds the size
+// limit.
+// All the functions are thread-safe. The configurations are passed in since
+// vconfig is not.
+class VRenderCache
+{
+public:
+    // Render @p_markdown of a note in notebook @p_notebookPath, or load it
+    // from the cache, whose size limit is @p_cacheSize MB. The result is also
+    // kept in the memory cache of VMarkdownConverter.
+    static VMarkdownRender render(const QString &p_notebookPath, const QString &p_markdown,
+                                  hoedown_extensions p_options, int p_cacheSize);
+
+    // Render all the Markdown notes of notebook @p_notebookPath not in the
+    // cache yet. Returns the number of notes rendered.
+    static int warmNotebook(const QString &p_notebookPath, hoedown_extensions p_options,
+                            int p_cacheSize);
+
+private:
+    static QString cacheFolder(const QString &p_notebookPath);
+    static QString cacheKey(const QString &p_markdown, hoedown_extensions p_options);
+    static bool load(const QString &p_filePath, VMarkdownRender &p_render);
+    static bool save(const QString &p_filePath, const VMarkdownRender &p_render);
+    // Remove the least recently used entries until the folder is within
+    // @p_cacheSize MB.
+    static void evict(const QString &p_folder, int p_cacheSize);
+
+    static const quint32 c_magic;
+    static const quint32 c_version;
+};
+
+#endif // VRENDERCACHE_H
@@ -0,0 +1,178 @@
+#include "vtextsnapshot.h"
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QDebug>
+#include "utils/vutils.h"
+
+// Number of blocks a chunk is split into. A change copies only the string
+// handles of the chunks it touches.
+static const int c_chunkBlocks = 256;
+
+VTextSnapshot::VTextSnapshot()
+    : m_blockCount(0), m_charCount(0), m_revision(0)
+{
+}
+
+int VTextSnapshot::findChunk(int p_blockNumber, int &p_offset) const
+{
+    int start = 0;
+    for (int i = 0; i < m_chunks.size(); ++i) {
+        int size = m_chunks[i].size();
+        if (p_blockNumber < start + size) {
+            p_offset = p_blockNumber - start;
+            return i;
+        }
+        start += size;
+    }
+    p_offset = -1;
+    return -1;
+}
+
+QString VTextSnapshot::blockText(int p_blockNumber) const
+{
+    int offset;
+    int idx = findChunk(p_blockNumber, offset);
+    if (idx == -1) {
+        return QString();
+    }
+    return m_chunks[idx][offset];
+}
+
+QString VTextSnapshot::toPlainText(bool (*p_skip)(const QString &)) const
+{
+    QString text;
+    text.reserve(m_charCount + m_blockCount);
+    bool first = true;
+    for (int i = 0; i < m_chunks.size(); ++i) {
+        const QVector<QString> &chunk = m_chunks[i];
+        for (int j = 0; j < chunk.size(); ++j) {
+            if (p_skip && p_skip(chunk[j])) {
+                continue;
+            }
+            if (!first) {
+                text.append('\n');
+            }
+            text.append(chunk[j]);
+            first = false;
+        }
+    }
+    return text;
+}
+
+void VTextSnapshot::replaceBlocks(int p_first, int p_removed,
+                                  const QVector<QString> &p_added)
+{
+    int offset = 0;
+    int idx = findChunk(p_first, offset);
+    if (idx == -1) {
+        // Append to the end.
+        if (m_chunks.isEmpty()) {
+            m_chunks.append(QVector<QString>());
+        }
+        idx = m_chunks.size() - 1;
+        offset = m_chunks[idx].size();
+    }
+
+    // Remove the blocks, which may span several chunks.
+    int left = p_removed;
+    int lastIdx = idx;
+    int pos = offset;
+    while (left > 0 && lastIdx < m_chunks.size()) {
+        QVector<QString> &chunk = m_chunks[lastIdx];
+        int nr = qMin(left, chunk.size() - pos);
+        for (int i = pos; i < pos + nr; ++i) {
+            m_charCount -= chunk[i].size();
+        }
+        chunk.remove(pos, nr);
+        left -= nr;
+        if (left > 0) {
+            ++lastIdx;
+            pos = 0;
+        }
+    }
+    Q_ASSERT(left == 0);
+    m_blockCount -= p_removed - left;
+
+    // Insert into the first chunk and split it if it grows too large.
+    QVector<QString> &chunk = m_chunks[idx];
+    for (int i = 0; i < p_added.size(); ++i) {
+        m_charCount += p_added[i].size();
+    }
+    m_blockCount += p_added.size();
+    if (!p_added.isEmpty()) {
+        QVector<QString> tail = chunk.mid(offset);
+        chunk.resize(offset);
+        chunk += p_added;
+        chunk += tail;
+    }
+
+    QVector<QVector<QString> > pieces;
+    if (chunk.size() > 2 * c_chunkBlocks) {
+        for (int i = 0; i < chunk.size(); i += c_chunkBlocks) {
+            pieces.append(chunk.mid(i, c_chunkBlocks));
+        }
+    } else if (!chunk.isEmpty()) {
+        pieces.append(chunk);
+    }
+
+    // Drop the emptied chunks.
+    for (int i = idx + 1; i <= lastIdx && i < m_chunks.size(); ++i) {
+        if (!m_chunks[i].isEmpty()) {
+            pieces.append(m_chunks[i]);
+        }
+    }
+    int nrOld = qMin(lastIdx, m_chunks.size() - 1) - idx + 1;
+    m_chunks.remove(idx, nrOld);
+    for (int i = 0; i < pieces.size(); ++i) {
+        m_chunks.insert(idx + i, pieces[i]);
+    }
+}
+
+VTextSnapshotTracker::VTextSnapshotTracker(QTextDocument *p_doc, QObject *p_parent)
+    : QObject(p_parent), m_doc(p_doc)
+{
+    reset();
+    connect(m_doc, &QTextDocument::contentsChange,
+            this, &VTextSnapshotTracker::handleContentsChange);
+}
+
+void VTextSnapshotTracker::reset()
+{
+    m_snapshot = VTextSnapshot();
+    QVector<QString> blocks;
+    blocks.reserve(m_doc->blockCount());
+    for (QTextBlock block = m_doc->begin(); block.isValid(); block = block.next()) {
+        blocks.append(block.text());
+    }
+    m_snapshot.replaceBlocks(0, 0, blocks);
+    m_snapshot.m_revision = m_doc->revision();
+}
+
+void VTextSnapshotTracker::handleContentsChange(int p_position, int p_charsRemoved,
+                                                int p_charsAdded)
+{
+    Q_UNUSED(p_charsRemoved);
+    QTextBlock firstBlock, lastBlock;
+    int oldLast;
+    bool synced = VUtils::changedBlocks(m_doc, p_position, p_charsAdded, m_snapshot.blockCount(),
+                                        firstBlock, lastBlock, oldLast);
+    int first = firstBlock.blockNumber();
+    int last = lastBlock.blockNumber();
+    if (!synced) {
+        qWarning() << "snapshot out of sync with the document" << first << oldLast
+                   << m_snapshot.blockCount();
+        reset();
+        return;
+    }
+
+    QVector<QString> blocks;
+    blocks.reserve(last - first + 1);
+    for (QTextBlock block = firstBlock; block.isValid(); block = block.next()) {
+        blocks.append(block.text());
+        if (block == lastBlock) {
+            break;
+        }
+    }
+    m_snapshot.replaceBlocks(first, oldLast - first + 1, blocks);
+    m_snapshot.m_revision = m_doc->revision();
+}
@@ -0,0 +1,88 @@
+#ifndef VTEXTSNAPSHOT_H
+#define VTEXTSNAPSHOT_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QTextDocument;
+
+// An immutable copy of the text of a QTextDocument, one string per block.
+// Blocks are kept in implicitly shared chunks, so copying a snapshot is O(1)
+// and snapshots share the chunks not changed in between. A snapshot could be
+// read from any thread without locks.
+class VTextSnapshot
+{
+public:
+    VTextSnapshot();
+
+    inline int blockCount() const;
+    // Characters excluding the block separators.
+    inline int charCount() const;
+    // Revision of the document when the snapshot is taken.
+    inline int revision() const;
+
+    QString blockText(int p_blockNumber) const;
+
+    // Blocks joined by '\n'. Blocks for which @p_skip returns true are left
+    // out.
+    QString toPlainText(bool (*p_skip)(const QString &) = NULL) const;
+
+private:
+    friend class VTextSnapshotTracker;
+
+    // Find the chunk holding block @p_blockNumber. @p_offset will be the index
+    // of the block within the chunk.
+    int findChunk(int p_blockNumber, int &p_offset) const;
+
+    // Replace @p_removed blocks from @p_first with @p_added.
+    void replaceBlocks(int p_first, int p_removed, const QVector<QString> &p_added);
+
+    QVector<QVector<QString> > m_chunks;
+    int m_blockCount;
+    int m_charCount;
+    int m_revision;
+};
+
+// Keep a VTextSnapshot in sync with the changes of a QTextDocument.
+class VTextSnapshotTracker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VTextSnapshotTracker(QTextDocument *p_doc, QObject *p_parent = 0);
+
+    // O(1) copy of current text.
+    inline VTextSnapshot snapshot() const;
+
+private slots:
+    void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+
+private:
+    // Copy all the blocks.
+    void reset();
+
+    QTextDocument *m_doc;
+    VTextSnapshot m_snapshot;
+};
+
+inline int VTextSnapshot::blockCount() const
+{
+    return m_blockCount;
+}
+
+inline int VTextSnapshot::charCount() const
+{
+    return m_charCount;
+}
+
+inline int VTextSnapshot::revision() const
+{
+    return m_revision;
+}
+
+inline VTextSnapshot VTextSnapshotTracker::snapshot() const
+{
+    return m_snapshot;
+}
+
+#endif // VTEXTSNAPSHOT_H
@@ -0,0 +1,113 @@
+#include <QGuiApplication>
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+#include <QDebug>
+#include "vtextsearcher.h"
+
+struct BenchCase
+{
+    QString m_pattern;
+    bool m_caseSensitive;
+    bool m_wholeWordOnly;
+};
+
+// Lines of mixed words, including case variants such as final sigma.
+static QString generateText(int p_size)
+{
+    const QStringList words = QStringList() << "lorem" << "Ipsum" << "dolor" << "SIT"
+                                            << "amet" << "consectetur" << "vnote" << "VNote"
+                                            << "markdown" << "σοφός" << "ΣΟΦΟΣ" << "λόγος"
+                                            << "Straße" << "kelvin" << "note" << "notebook";
+    QString text;
+    text.reserve(p_size + 64);
+    int i = 0;
+    while (text.size() < p_size) {
+        text.append(words[(i * 7 + i / 5) % words.size()]);
+        text.append(++i % 12 == 0 ? '\n' : ' ');
+    }
+    return text;
+}
+
+static int findByDocument(QTextDocument *p_doc, const BenchCase &p_case)
+{
+    QTextDocument::FindFlags flags;
+    if (p_case.m_caseSensitive) {
+        flags |= QTextDocument::FindCaseSensitively;
+    }
+    if (p_case.m_wholeWordOnly) {
+        flags |= QTextDocument::FindWholeWords;
+    }
+    int count = 0;
+    QTextCursor cursor(p_doc);
+    while (true) {
+        cursor = p_doc->find(p_case.m_pattern, cursor, flags);
+        if (cursor.isNull()) {
+            break;
+        }
+        ++count;
+    }
+    return count;
+}
+
+static int findBySearcher(const QString &p_text, const BenchCase &p_case)
+{
+    VTextSearcher searcher(p_case.m_pattern, p_case.m_caseSensitive, p_case.m_wholeWordOnly);
+    QVector<int> offsets;
+    searcher.findAll(p_text, offsets);
+    return offsets.size();
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+
+    int sizeMB = 8;
+    if (argc > 1) {
+        sizeMB = qMax(1, QString(argv[1]).toInt());
+    }
+    QString text = generateText(sizeMB * 1024 * 1024);
+    QTextDocument doc;
+    doc.setPlainText(text);
+    // The snapshot a search of the editor runs on.
+    text = doc.toPlainText();
+
+    QVector<BenchCase> cases;
+    cases << BenchCase{"vnote", true, false}
+          << BenchCase{"vnote", false, false}
+          << BenchCase{"note", false, true}
+          << BenchCase{"consectetur amet", false, false}
+          << BenchCase{"σοφόσ", false, false}
+          << BenchCase{"strasse", false, false}
+          << BenchCase{"notfound", false, false};
+
+    qDebug() << "text of" << text.size() << "characters";
+    bool mismatched = false;
+    for (int i = 0; i < cases.size(); ++i) {
+        const BenchCase &bc = cases[i];
+        QElapsedTimer timer;
+        timer.start();
+        int docCount = findByDocument(&doc, bc);
+        qint64 docMs = timer.restart();
+        int searcherCount = findBySearcher(text, bc);
+        qint64 searcherMs = timer.elapsed();
+
+        qDebug().noquote() << QString("%1 case:%2 word:%3 | QTextDocument %4 in %5 ms"
+                                      " | VTextSearcher %6 in %7 ms")
+                              .arg(bc.m_pattern, -16)
+                              .arg(bc.m_caseSensitive)
+                              .arg(bc.m_wholeWordOnly)
+                              .arg(docCount).arg(docMs)
+                              .arg(searcherCount).arg(searcherMs);
+        if (docCount != searcherCount) {
+            mismatched = true;
+        }
+    }
+    if (mismatched) {
+        qWarning() << "match counts differ";
+        return 1;
+    }
+    return 0;
+}
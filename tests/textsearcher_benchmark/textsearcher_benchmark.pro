@@ -0,0 +1,18 @@
+# Micro-benchmark of VTextSearcher against QTextDocument::find().
+# Not part of VNote.pro. Build and run it alone:
+#   qmake && make && ./textsearcher_benchmark [size in MB]
+
+QT += core gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = textsearcher_benchmark
+TEMPLATE = app
+
+INCLUDEPATH += ../../src/utils
+
+SOURCES += main.cpp \
+    ../../src/utils/vtextsearcher.cpp
+
+HEADERS += ../../src/utils/vtextsearcher.h